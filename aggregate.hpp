@@ -0,0 +1,87 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "linkedList.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ezlib {
+
+// Number of threads worth starting for `items` rows: one per core, but no
+// thread gets fewer than `minPerWorker` rows.
+inline unsigned workerCount(std::size_t items,
+                            std::size_t minPerWorker = 16384) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t wanted = items / minPerWorker + 1;
+    return static_cast<unsigned>(std::min<std::size_t>(cores, wanted));
+}
+
+// Splits the list into `parts` consecutive ranges of about the same length.
+// Returns parts + 1 boundaries, the last one is end().
+template <typename T>
+std::vector<ConstIterator<T>> partition(const LinkedList<T> &list,
+                                        unsigned parts) {
+    std::vector<ConstIterator<T>> bounds;
+    bounds.reserve(parts + 1);
+    std::size_t step = list.size / parts + (list.size % parts != 0);
+    std::size_t i = 0;
+    for (ConstIterator<T> it = list.begin(); it != list.end(); ++it, ++i) {
+        if (i % step == 0) {
+            bounds.push_back(it);
+        }
+    }
+    while (bounds.size() <= parts) {
+        bounds.push_back(list.end());
+    }
+    return bounds;
+}
+
+// Hash group-by over a list. Every worker fills its own map for one range of
+// the list, the maps are merged at the end.
+//   keyOf(const T &) -> Key
+//   add(Acc &, const T &) folds a row into its group
+//   Acc::merge(const Acc &) combines partial results
+template <typename Key, typename Acc, typename T, typename KeyFn,
+          typename AddFn, typename Hash = std::hash<Key>>
+std::unordered_map<Key, Acc, Hash> groupBy(const LinkedList<T> &list,
+                                           KeyFn keyOf,
+                                           AddFn add, unsigned threads = 0) {
+    using Map = std::unordered_map<Key, Acc, Hash>;
+    if (threads == 0) {
+        threads = workerCount(list.size);
+    }
+    std::vector<ConstIterator<T>> bounds = partition(list, threads);
+    std::vector<Map> partials(threads);
+    auto work = [&](unsigned part) {
+        Map &groups = partials[part];
+        for (ConstIterator<T> it = bounds[part]; it != bounds[part + 1];
+             ++it) {
+            add(groups[keyOf(*it)], *it);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned part = 1; part < threads; ++part) {
+        workers.emplace_back(work, part);
+    }
+    work(0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    Map &result = partials[0];
+    for (unsigned part = 1; part < threads; ++part) {
+        for (auto &group : partials[part]) {
+            result[group.first].merge(group.second);
+        }
+    }
+    return std::move(result);
+}
+
+} // namespace ezlib
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "aggregate.hpp"
+#include "records.hpp"
+#include "table.hpp"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct SalesTotals {
+    ezlib::Weight weight;
+    ezlib::Money revenue;
+
+    void merge(const SalesTotals &other) {
+        weight += other.weight;
+        revenue += other.revenue;
+    }
+};
+
+struct ProductSummary {
+    long products = 0;
+    ezlib::Weight units;
+    // Stock at buy price, and the profit of selling all of it.
+    ezlib::Money stockValue;
+    ezlib::Money margin;
+    SalesTotals sales;
+
+    void merge(const ProductSummary &other) {
+        products += other.products;
+        units += other.units;
+        stockValue += other.stockValue;
+        margin += other.margin;
+        sales.merge(other.sales);
+    }
+};
+
+// Stock of one group gathered column by column and valued a batch at a time
+// through ezlib::totalPrice.
+struct StockColumns {
+    static constexpr std::size_t batch = 1024;
+
+    ProductSummary summary;
+    std::vector<std::int64_t> weights;
+    std::vector<std::int64_t> buyPrices;
+    std::vector<std::int64_t> sellPrices;
+
+    void add(ezlib::Weight weight, ezlib::Money buy, ezlib::Money sell) {
+        weights.push_back(weight.minor());
+        buyPrices.push_back(buy.minor());
+        sellPrices.push_back(sell.minor());
+        if (weights.size() == batch) {
+            flush();
+        }
+    }
+
+    void flush() {
+        ezlib::Money cost = ezlib::totalPrice(
+            weights.data(), buyPrices.data(), weights.size());
+        summary.stockValue += cost;
+        summary.margin += ezlib::totalPrice(weights.data(), sellPrices.data(),
+                                            weights.size()) -
+                          cost;
+        weights.clear();
+        buyPrices.clear();
+        sellPrices.clear();
+    }
+
+    void merge(const StockColumns &other) {
+        summary.merge(other.summary);
+        for (std::size_t i = 0; i < other.weights.size(); ++i) {
+            add(ezlib::Weight::fromMinor(other.weights[i]),
+                ezlib::Money::fromMinor(other.buyPrices[i]),
+                ezlib::Money::fromMinor(other.sellPrices[i]));
+        }
+    }
+};
+
+enum class ProductGroup { Category, Manufacturer };
+
+// Stock and sales figures per category or manufacturer. Revenue rows are
+// joined to products by article.
+inline std::unordered_map<ezlib::Interned, ProductSummary>
+summarizeProducts(const ezlib::LinkedList<Product> &products,
+                  const ezlib::LinkedList<Revenue> &revenue, ProductGroup group,
+                  unsigned threads = 0) {
+    auto sold = ezlib::groupBy<unsigned int, SalesTotals>(
+        revenue, [](const Revenue &rev) { return rev.article; },
+        [](SalesTotals &acc, const Revenue &rev) {
+            acc.weight += rev.weightBuyed;
+            acc.revenue += rev.revenue;
+        },
+        threads);
+
+    auto keyOf = [group](const Product &prod) {
+        return group == ProductGroup::Category ? prod.category
+                                               : prod.manufacturer;
+    };
+    auto add = [&sold](StockColumns &acc, const Product &prod) {
+        acc.summary.products++;
+        acc.summary.units += prod.availability;
+        acc.add(prod.availability, prod.buyPrice, prod.sellPrice);
+        auto found = sold.find(static_cast<unsigned int>(prod.article));
+        if (found != sold.end()) {
+            acc.summary.sales.merge(found->second);
+        }
+    };
+    auto stock = ezlib::groupBy<ezlib::Interned, StockColumns>(
+        products, keyOf, add, threads);
+    std::unordered_map<ezlib::Interned, ProductSummary> ret;
+    for (auto &group : stock) {
+        group.second.flush();
+        ret.emplace(group.first, group.second.summary);
+    }
+    return ret;
+}
+
+inline void addSummary(
+    ezlib::Table *tab, const std::string &groupName,
+    const std::unordered_map<ezlib::Interned, ProductSummary> &summary) {
+    std::vector<std::pair<ezlib::Interned, ProductSummary>> sorted(
+        summary.begin(), summary.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<ezlib::Interned, ProductSummary> &lhs,
+                 const std::pair<ezlib::Interned, ProductSummary> &rhs) {
+                  return lhs.first < rhs.first;
+              });
+    tab->addRow({groupName, "Products", "Units", "Stock value", "Margin",
+                 "Weight sold", "Revenue"});
+    for (const auto &row : sorted) {
+        tab->addRow({row.first, std::to_string(row.second.products),
+                     row.second.units.str(), row.second.stockValue.str(),
+                     row.second.margin.str(), row.second.sales.weight.str(),
+                     row.second.sales.revenue.str()});
+    }
+}
+
+#endif
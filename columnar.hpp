@@ -0,0 +1,291 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "fixed.hpp"
+#include "intern.hpp"
+#include "serialize.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ezlib {
+
+// A block of records stored column by column. Records describe themselves
+// with a static fields(self, visit) function that calls visit on every
+// member; strings (plain or interned), integers, fixed point numbers and
+// floats are supported.
+//
+// Encoding per column:
+//  - integers and fixed point numbers: zigzag varint of the delta to the
+//    previous row
+//  - floats: byte planes (all first bytes, then all second bytes, ...)
+//  - strings: a dictionary and varint ids when there are few distinct values,
+//    otherwise varint length + bytes
+class ColumnBlock {
+  public:
+    enum class Kind { Int, Float, String };
+
+    struct Column {
+        Kind kind;
+        // Members of type Interned, decoded into handles.
+        bool interned = false;
+        std::vector<std::int64_t> ints;
+        std::vector<float> floats;
+        // After decoding a dictionary block, strings (and handles) hold the
+        // dictionary and ids the entry of every row.
+        std::vector<std::string> strings;
+        std::vector<Interned> handles;
+        std::vector<std::uint32_t> ids;
+
+        explicit Column(Kind k) : kind(k) {}
+
+        std::size_t slot(std::size_t row) const {
+            return ids.empty() ? row : ids[row];
+        }
+    };
+
+  private:
+    std::vector<Column> columns;
+    std::size_t rows = 0;
+
+    class Collector {
+      private:
+        std::vector<Column> &columns;
+        Kind fixedKind;
+        std::size_t index = 0;
+
+        Column &next(Kind kind) {
+            if (index == columns.size()) {
+                columns.emplace_back(kind);
+            }
+            return columns[index++];
+        }
+
+      public:
+        Collector(std::vector<Column> &cols, Kind fixed)
+            : columns(cols), fixedKind(fixed) {}
+
+        void operator()(const std::string &value) {
+            next(Kind::String).strings.push_back(value);
+        }
+        void operator()(const Interned &value) {
+            Column &column = next(Kind::String);
+            column.interned = true;
+            column.strings.push_back(value);
+        }
+        void operator()(const float &value) {
+            next(Kind::Float).floats.push_back(value);
+        }
+        template <typename Tag, std::int64_t Scale>
+        void operator()(const Fixed<Tag, Scale> &value) {
+            Column &column = next(fixedKind);
+            if (column.kind == Kind::Float) {
+                column.floats.push_back(static_cast<float>(value.toDouble()));
+            } else {
+                column.ints.push_back(value.minor());
+            }
+        }
+        template <typename P>
+        typename std::enable_if<std::is_integral<P>::value>::type
+        operator()(const P &value) {
+            next(Kind::Int).ints.push_back(static_cast<std::int64_t>(value));
+        }
+    };
+
+    class Filler {
+      private:
+        const std::vector<Column> &columns;
+        std::size_t row;
+        std::size_t index = 0;
+
+      public:
+        Filler(const std::vector<Column> &cols, std::size_t r)
+            : columns(cols), row(r) {}
+
+        void operator()(std::string &value) {
+            const Column &column = columns[index++];
+            value = column.strings[column.slot(row)];
+        }
+        void operator()(Interned &value) {
+            const Column &column = columns[index++];
+            if (column.handles.empty()) {
+                value = column.strings[column.slot(row)];
+            } else {
+                value = column.handles[column.slot(row)];
+            }
+        }
+        void operator()(float &value) { value = columns[index++].floats[row]; }
+        template <typename Tag, std::int64_t Scale>
+        void operator()(Fixed<Tag, Scale> &value) {
+            const Column &column = columns[index++];
+            value = column.kind == Kind::Float
+                        ? Fixed<Tag, Scale>::fromDouble(column.floats[row])
+                        : Fixed<Tag, Scale>::fromMinor(column.ints[row]);
+        }
+        template <typename P>
+        typename std::enable_if<std::is_integral<P>::value>::type
+        operator()(P &value) {
+            value = static_cast<P>(columns[index++].ints[row]);
+        }
+    };
+
+    static void encodeStrings(BufferWriter &out,
+                              const std::vector<std::string> &values) {
+        std::unordered_map<std::string, std::uint64_t> ids;
+        std::vector<const std::string *> dict;
+        for (const std::string &value : values) {
+            if (ids.emplace(value, dict.size()).second) {
+                dict.push_back(&value);
+            }
+            if (dict.size() * 2 > values.size()) {
+                break;
+            }
+        }
+        if (dict.size() * 2 > values.size()) {
+            out.putVarint(0);
+            for (const std::string &value : values) {
+                out.putVarint(value.size());
+                out.append(value);
+            }
+            return;
+        }
+        out.putVarint(1);
+        out.putVarint(dict.size());
+        for (const std::string *value : dict) {
+            out.putVarint(value->size());
+            out.append(*value);
+        }
+        for (const std::string &value : values) {
+            out.putVarint(ids[value]);
+        }
+    }
+
+    static std::string readString(BufferReader &in) {
+        std::uint64_t len = in.getVarint();
+        const char *data = in.skip(len);
+        return std::string(data, len);
+    }
+
+    // Leaves a dictionary block as it is stored, so every distinct string
+    // is copied, and interned, once per block.
+    static void decodeStrings(BufferReader &in, Column &column,
+                              std::size_t count) {
+        column.strings.clear();
+        column.ids.clear();
+        bool dictionary = in.getVarint() != 0;
+        std::size_t size = dictionary ? in.getVarint() : count;
+        column.strings.reserve(std::min<std::size_t>(size, count));
+        for (std::size_t i = 0; i < size; ++i) {
+            column.strings.push_back(readString(in));
+        }
+        if (dictionary) {
+            column.ids.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                std::uint64_t id = in.getVarint();
+                if (id >= size) {
+                    throw std::runtime_error("Malformed string column");
+                }
+                column.ids[i] = static_cast<std::uint32_t>(id);
+            }
+        }
+        if (column.interned) {
+            Interned::internAll(column.strings, column.handles);
+        }
+    }
+
+  public:
+    // Fixes the column layout from a default constructed record so blocks
+    // can be decoded. With `floatFixed` fixed point members are float
+    // columns, as in blocks written before they existed.
+    template <typename R> void setSchema(bool floatFixed = false) {
+        R probe{};
+        columns.clear();
+        Collector collector(columns, floatFixed ? Kind::Float : Kind::Int);
+        R::fields(probe, collector);
+        clear();
+    }
+
+    void clear() {
+        for (Column &column : columns) {
+            column.ints.clear();
+            column.floats.clear();
+            column.strings.clear();
+            column.handles.clear();
+            column.ids.clear();
+        }
+        rows = 0;
+    }
+
+    std::size_t size() const { return rows; }
+
+    template <typename R> void add(const R &row) {
+        Collector collector(columns, Kind::Int);
+        R::fields(row, collector);
+        ++rows;
+    }
+
+    template <typename R> void get(std::size_t row, R &out) const {
+        Filler filler(columns, row);
+        R::fields(out, filler);
+    }
+
+    std::string encode() const {
+        std::string ret;
+        BufferWriter out(ret);
+        for (const Column &column : columns) {
+            if (column.kind == Kind::Int) {
+                std::int64_t prev = 0;
+                for (std::int64_t value : column.ints) {
+                    out.putVarint(zigzag(value - prev));
+                    prev = value;
+                }
+            } else if (column.kind == Kind::Float) {
+                const char *raw =
+                    reinterpret_cast<const char *>(column.floats.data());
+                for (std::size_t b = 0; b < sizeof(float); ++b) {
+                    for (std::size_t i = 0; i < column.floats.size(); ++i) {
+                        ret += raw[i * sizeof(float) + b];
+                    }
+                }
+            } else {
+                encodeStrings(out, column.strings);
+            }
+        }
+        return ret;
+    }
+
+    void decode(const char *data, std::size_t size, std::size_t count) {
+        BufferReader in(data, size);
+        for (Column &column : columns) {
+            if (column.kind == Kind::Int) {
+                column.ints.resize(count);
+                std::int64_t prev = 0;
+                for (std::size_t i = 0; i < count; ++i) {
+                    prev += unzigzag(in.getVarint());
+                    column.ints[i] = prev;
+                }
+            } else if (column.kind == Kind::Float) {
+                column.floats.resize(count);
+                char *raw = reinterpret_cast<char *>(column.floats.data());
+                for (std::size_t b = 0; b < sizeof(float); ++b) {
+                    const char *plane = in.skip(count);
+                    for (std::size_t i = 0; i < count; ++i) {
+                        raw[i * sizeof(float) + b] = plane[i];
+                    }
+                }
+            } else {
+                decodeStrings(in, column, count);
+            }
+        }
+        rows = count;
+    }
+};
+
+} // namespace ezlib
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ezlib {
+
+// Small LZ77 compressor in the spirit of LZ4 block format. Every sequence is
+// a token byte (literal length << 4 | match length - 4), optional extra
+// length bytes, the literals, and a 2 byte match offset. The last sequence
+// has literals only.
+
+namespace lz {
+constexpr int hashBits = 14;
+constexpr std::size_t minMatch = 4;
+constexpr std::size_t maxOffset = 65535;
+
+inline std::uint32_t read32(const char *p) {
+    std::uint32_t ret;
+    std::memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+inline void putLength(std::string &out, std::size_t len) {
+    for (; len >= 255; len -= 255) {
+        out += static_cast<char>(255);
+    }
+    out += static_cast<char>(len);
+}
+
+inline void putSequence(std::string &out, const char *literals,
+                        std::size_t litLen, std::size_t offset,
+                        std::size_t matchLen) {
+    std::size_t extra = matchLen > 0 ? matchLen - minMatch : 0;
+    out += static_cast<char>(((litLen < 15 ? litLen : 15) << 4) |
+                             (extra < 15 ? extra : 15));
+    if (litLen >= 15) {
+        putLength(out, litLen - 15);
+    }
+    out.append(literals, litLen);
+    if (matchLen == 0) {
+        return;
+    }
+    out += static_cast<char>(offset & 0xff);
+    out += static_cast<char>(offset >> 8);
+    if (extra >= 15) {
+        putLength(out, extra - 15);
+    }
+}
+} // namespace lz
+
+inline std::string compress(const char *src, std::size_t size) {
+    std::string out;
+    out.reserve(size / 2 + 16);
+    std::vector<std::int64_t> table(1 << lz::hashBits, -1);
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    while (i + lz::minMatch <= size) {
+        std::uint32_t seq = lz::read32(src + i);
+        std::uint32_t hash = (seq * 2654435761u) >> (32 - lz::hashBits);
+        std::int64_t candidate = table[hash];
+        table[hash] = i;
+        if (candidate >= 0 && i - candidate <= lz::maxOffset &&
+            lz::read32(src + candidate) == seq) {
+            std::size_t len = lz::minMatch;
+            while (i + len < size && src[candidate + len] == src[i + len]) {
+                ++len;
+            }
+            lz::putSequence(out, src + anchor, i - anchor, i - candidate, len);
+            i += len;
+            anchor = i;
+        } else {
+            ++i;
+        }
+    }
+    lz::putSequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+inline std::string decompress(const char *src, std::size_t size,
+                              std::size_t rawSize) {
+    std::string out;
+    out.reserve(rawSize);
+    const char *end = src + size;
+    auto length = [&src, end](std::size_t len) {
+        if (len != 15) {
+            return len;
+        }
+        unsigned char b;
+        do {
+            if (src == end) {
+                throw std::runtime_error("Corrupted compressed data");
+            }
+            b = static_cast<unsigned char>(*src++);
+            len += b;
+        } while (b == 255);
+        return len;
+    };
+    while (src < end) {
+        unsigned char token = static_cast<unsigned char>(*src++);
+        std::size_t litLen = length(token >> 4);
+        if (static_cast<std::size_t>(end - src) < litLen ||
+            out.size() + litLen > rawSize) {
+            throw std::runtime_error("Corrupted compressed data");
+        }
+        out.append(src, litLen);
+        src += litLen;
+        if (src == end) {
+            break;
+        }
+        if (end - src < 2) {
+            throw std::runtime_error("Corrupted compressed data");
+        }
+        std::size_t offset = static_cast<unsigned char>(src[0]) |
+                             (static_cast<unsigned char>(src[1]) << 8);
+        src += 2;
+        std::size_t matchLen = length(token & 15) + lz::minMatch;
+        if (offset == 0 || offset > out.size() ||
+            out.size() + matchLen > rawSize) {
+            throw std::runtime_error("Corrupted compressed data");
+        }
+        std::size_t from = out.size() - offset;
+        for (std::size_t i = 0; i < matchLen; ++i) {
+            out += out[from + i];
+        }
+    }
+    if (out.size() != rawSize) {
+        throw std::runtime_error("Corrupted compressed data");
+    }
+    return out;
+}
+
+} // namespace ezlib
+
+#endif
@@ -0,0 +1,856 @@
+#ifndef ELEMTABLE_H
+#define ELEMTABLE_H
+
+#include "aggregate.hpp"
+#include "columnar.hpp"
+#include "compress.hpp"
+#include "fixed.hpp"
+#include "intern.hpp"
+#include "leaderboard.hpp"
+#include "linkedList.hpp"
+#include "mappedFile.hpp"
+#include "rangeIndex.hpp"
+#include "serialize.hpp"
+#include "stats.hpp"
+#include "textIndex.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+// Identifies one saved state of a table file. Sidecar files are only trusted
+// when they carry the same stamp as the data file they describe.
+struct TableStamp {
+    std::uint64_t generation;
+    std::uint64_t checksum;
+    std::uint64_t count;
+};
+
+// Index keys are compared bytewise, so numbers are stored big-endian with the
+// sign bit flipped to keep their natural order.
+inline std::string encodeKey(const std::string &key) { return key; }
+
+inline std::string encodeKey(unsigned int key) {
+    std::string ret(4, '\0');
+    for (int i = 3; i >= 0; --i) {
+        ret[i] = static_cast<char>(key & 0xff);
+        key >>= 8;
+    }
+    return ret;
+}
+
+inline std::string encodeKey(int key) {
+    return encodeKey(static_cast<unsigned int>(key) ^ 0x80000000u);
+}
+
+// Writes to a temporary file first so readers (and mappings of the old file)
+// never see a half written file.
+inline bool replaceFile(const std::string &path, const std::string &data) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::binary |
+                                   std::ios::trunc);
+        if (!out.write(data.data(), data.size())) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Sorted key -> record map kept in a sidecar file next to the table. The
+// saved part is used straight from the mapping; rows added, removed or
+// re-keyed afterwards are tracked in memory until the next save.
+template <typename T> class KeyIndex {
+  public:
+    using KeyFunc = std::function<std::string(const T &)>;
+
+  private:
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t generation;
+        std::uint64_t dataChecksum;
+        std::uint64_t recordCount;
+        std::uint64_t entryCount;
+        std::uint64_t blobSize;
+        std::uint64_t checksum;
+    };
+    struct Entry {
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        std::uint32_t ordinal;
+        std::uint32_t reserved;
+        std::uint64_t recordOffset;
+    };
+
+    std::string path;
+    KeyFunc keyOf;
+    ezlib::MappedFile mapped;
+    std::string built;
+    const Entry *entries = nullptr;
+    std::size_t entryCount = 0;
+    const char *blob = nullptr;
+    const std::vector<T *> *rows = nullptr;
+    std::vector<bool> dead;
+    std::multimap<std::string, T *> added;
+
+    int compare(const Entry &entry, const std::string &key) const {
+        std::size_t len = std::min<std::size_t>(entry.keyLength, key.size());
+        int ret = std::memcmp(blob + entry.keyOffset, key.data(), len);
+        if (ret != 0) {
+            return ret;
+        }
+        if (entry.keyLength == key.size()) {
+            return 0;
+        }
+        return entry.keyLength < key.size() ? -1 : 1;
+    }
+
+    const Entry *lowerBound(const std::string &key) const {
+        return std::lower_bound(entries, entries + entryCount, key,
+                                [this](const Entry &e, const std::string &k) {
+                                    return compare(e, k) < 0;
+                                });
+    }
+
+    bool use(const char *image, std::size_t size, const TableStamp &stamp) {
+        if (size < sizeof(Header)) {
+            return false;
+        }
+        Header header;
+        std::memcpy(&header, image, sizeof(Header));
+        if (std::memcmp(header.magic, "EZIX", 4) != 0 || header.version != 1 ||
+            header.generation != stamp.generation ||
+            header.dataChecksum != stamp.checksum ||
+            header.recordCount != stamp.count ||
+            size != sizeof(Header) + header.entryCount * sizeof(Entry) +
+                        header.blobSize) {
+            return false;
+        }
+        const char *body = image + sizeof(Header);
+        if (ezlib::checksum(body, size - sizeof(Header)) != header.checksum) {
+            return false;
+        }
+        entries = reinterpret_cast<const Entry *>(body);
+        entryCount = header.entryCount;
+        blob = body + entryCount * sizeof(Entry);
+        return true;
+    }
+
+  public:
+    KeyIndex(const std::string &file, KeyFunc func)
+        : path(file), keyOf(std::move(func)) {}
+
+    static std::string makeImage(const KeyFunc &keyOf, const TableStamp &stamp,
+                                 const std::vector<T *> &records,
+                                 const std::vector<std::uint64_t> &offsets) {
+        std::vector<std::pair<std::string, std::uint32_t>> keys;
+        keys.reserve(records.size());
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            keys.emplace_back(keyOf(*records[i]), i);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::string image(sizeof(Header) + keys.size() * sizeof(Entry), '\0');
+        std::string keyBlob;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            Entry entry{};
+            entry.keyOffset = keyBlob.size();
+            entry.keyLength = keys[i].first.size();
+            entry.ordinal = keys[i].second;
+            entry.recordOffset = offsets[keys[i].second];
+            keyBlob += keys[i].first;
+            std::memcpy(&image[sizeof(Header) + i * sizeof(Entry)], &entry,
+                        sizeof(Entry));
+        }
+        image += keyBlob;
+
+        Header header{};
+        std::memcpy(header.magic, "EZIX", 4);
+        header.version = 1;
+        header.generation = stamp.generation;
+        header.dataChecksum = stamp.checksum;
+        header.recordCount = stamp.count;
+        header.entryCount = keys.size();
+        header.blobSize = keyBlob.size();
+        header.checksum = ezlib::checksum(image.data() + sizeof(Header),
+                                          image.size() - sizeof(Header));
+        std::memcpy(&image[0], &header, sizeof(Header));
+        return image;
+    }
+
+    // Maps the sidecar file, returns false if it is missing or stale.
+    bool open(const TableStamp &stamp, const std::vector<T *> &records) {
+        rows = &records;
+        if (!mapped.open(path)) {
+            return false;
+        }
+        if (!use(mapped.data(), mapped.size(), stamp)) {
+            mapped.close();
+            return false;
+        }
+        return true;
+    }
+
+    void rebuild(const TableStamp &stamp, const std::vector<T *> &records,
+                 const std::vector<std::uint64_t> &offsets) {
+        rows = &records;
+        mapped.close();
+        built = makeImage(keyOf, stamp, records, offsets);
+        use(built.data(), built.size(), stamp);
+        replaceFile(path, built);
+    }
+
+    void write(const TableStamp &stamp, const std::vector<T *> &records,
+               const std::vector<std::uint64_t> &offsets) const {
+        replaceFile(path, makeImage(keyOf, stamp, records, offsets));
+    }
+
+    std::string key(const T &row) const { return keyOf(row); }
+
+    T *find(const std::string &key) const {
+        for (const Entry *it = lowerBound(key);
+             it != entries + entryCount && compare(*it, key) == 0; ++it) {
+            if (dead.empty() || !dead[it->ordinal]) {
+                return (*rows)[it->ordinal];
+            }
+        }
+        auto found = added.find(key);
+        if (found != added.end()) {
+            return found->second;
+        }
+        return nullptr;
+    }
+
+    // Every row with `key`, not only the first one as find.
+    std::vector<T *> findAll(const std::string &key) const {
+        std::vector<T *> ret;
+        for (const Entry *it = lowerBound(key);
+             it != entries + entryCount && compare(*it, key) == 0; ++it) {
+            if (dead.empty() || !dead[it->ordinal]) {
+                ret.push_back((*rows)[it->ordinal]);
+            }
+        }
+        auto range = added.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            ret.push_back(it->second);
+        }
+        return ret;
+    }
+
+    void insert(T *row, const std::string &key) { added.emplace(key, row); }
+
+    void erase(T *row, const std::string &key) {
+        auto range = added.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == row) {
+                added.erase(it);
+                return;
+            }
+        }
+        for (const Entry *it = lowerBound(key);
+             it != entries + entryCount && compare(*it, key) == 0; ++it) {
+            if ((*rows)[it->ordinal] == row) {
+                if (dead.empty()) {
+                    dead.resize(rows->size(), false);
+                }
+                dead[it->ordinal] = true;
+                return;
+            }
+        }
+    }
+};
+
+// Reads one stored member of a row. Tables before version 2 kept fixed point
+// members as floats.
+template <typename V>
+void readField(ezlib::BufferReader &in, V &value, bool /*floatFixed*/) {
+    in.get(value);
+}
+
+template <typename Tag, std::int64_t Scale>
+void readField(ezlib::BufferReader &in, ezlib::Fixed<Tag, Scale> &value,
+               bool floatFixed) {
+    if (!floatFixed) {
+        in.get(value);
+        return;
+    }
+    float stored;
+    in.get(stored);
+    value = ezlib::Fixed<Tag, Scale>::fromDouble(stored);
+}
+
+// Reads the stored members of one row. Interned members go through the
+// cache of the loader thread.
+class RowReader {
+  private:
+    ezlib::BufferReader &in;
+    bool floatFixed;
+    ezlib::InternCache &cache;
+    std::string text;
+
+  public:
+    RowReader(ezlib::BufferReader &record, bool fixed, ezlib::InternCache &c)
+        : in(record), floatFixed(fixed), cache(c) {}
+
+    template <typename V> void operator()(V &value) {
+        readField(in, value, floatFixed);
+    }
+    void operator()(ezlib::Interned &value) {
+        in.get(text);
+        value = cache.get(text);
+    }
+};
+
+// Rows writes records one after another; Columns stores blocks of
+// compressed columns (see ColumnBlock), which is smaller and faster to read
+// from slow disks.
+enum class TableFormat { Rows, Columns };
+
+// Table of records kept in a binary file. T must provide a static
+// fields(self, visit) function listing its stored members.
+template <typename T> class ElemTable {
+  private:
+    static constexpr std::size_t blockRows = 4096;
+    // Version 1 stored money and weights as floats.
+    static constexpr std::uint32_t formatVersion = 2;
+
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t generation;
+        std::uint64_t count;
+        std::uint64_t checksum;
+    };
+
+    ezlib::LinkedList<T> elements;
+    std::string tableName;
+    // Rows as they were loaded, by position in the file.
+    std::vector<T *> ordinals;
+    std::vector<std::uint64_t> offsets;
+    std::map<std::type_index, std::unique_ptr<KeyIndex<T>>> indexes;
+    std::vector<std::unique_ptr<RowIndex<T>>> rowIndexes;
+    TableStamp stamp;
+    TableFormat format;
+    int length;
+    bool isWrite;
+
+    void indexRow(T *row) {
+        for (auto &index : indexes) {
+            index.second->insert(row, index.second->key(*row));
+        }
+        for (auto &index : rowIndexes) {
+            index->insert(row);
+        }
+    }
+
+    void unindexRow(T *row) {
+        for (auto &index : indexes) {
+            index.second->erase(row, index.second->key(*row));
+        }
+        for (auto &index : rowIndexes) {
+            index->erase(row);
+        }
+    }
+
+    TextIndex<T> &getTextIndex() {
+        for (auto &index : rowIndexes) {
+            auto typed = dynamic_cast<TextIndex<T> *>(index.get());
+            if (typed != nullptr) {
+                return *typed;
+            }
+        }
+        throw std::runtime_error("No text index on this table");
+    }
+
+    template <typename V> RangeIndex<T, V> &getRangeIndex(V T::*field) {
+        for (auto &index : rowIndexes) {
+            auto typed = dynamic_cast<RangeIndex<T, V> *>(index.get());
+            if (typed != nullptr && typed->getField() == field) {
+                return *typed;
+            }
+        }
+        throw std::runtime_error("No range index on this field");
+    }
+
+    // Rows decoded by one loader thread.
+    struct LoadPart {
+        ezlib::LinkedList<T> rows;
+        std::vector<T *> ordinals;
+        std::vector<std::uint64_t> offsets;
+        std::exception_ptr error;
+
+        void append(const T &elem, std::uint64_t offset) {
+            rows.push_back(elem);
+            ordinals.push_back(&*(--rows.end()));
+            offsets.push_back(offset);
+        }
+    };
+
+    // Runs decode(part, i) for every part on its own thread, then moves the
+    // rows of the parts, in order, to the end of the table.
+    template <typename Decode>
+    void loadParts(std::size_t count, Decode decode) {
+        std::vector<LoadPart> parts(count);
+        auto work = [&parts, &decode](std::size_t i) {
+            try {
+                decode(parts[i], i);
+            } catch (...) {
+                parts[i].error = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < count; ++i) {
+            workers.emplace_back(work, i);
+        }
+        if (count > 0) {
+            work(0);
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        for (LoadPart &part : parts) {
+            if (part.error) {
+                std::rethrow_exception(part.error);
+            }
+        }
+        for (LoadPart &part : parts) {
+            elements.splice(elements.end(), part.rows);
+            ordinals.insert(ordinals.end(), part.ordinals.begin(),
+                            part.ordinals.end());
+            offsets.insert(offsets.end(), part.offsets.begin(),
+                           part.offsets.end());
+        }
+    }
+
+    // Finds where every part starts by hopping over the size prefixes, then
+    // decodes the parts in parallel.
+    void loadRows(const char *data, ezlib::BufferReader &in,
+                  std::uint64_t count, bool floatFixed) {
+        std::uint64_t step = count / ezlib::workerCount(count) + 1;
+        std::vector<const char *> starts;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            if (i % step == 0) {
+                starts.push_back(in.position());
+            }
+            std::uint32_t recordSize;
+            in.get(recordSize);
+            in.skip(recordSize);
+        }
+        const char *end = in.position();
+        loadParts(starts.size(), [&](LoadPart &part, std::size_t i) {
+            std::uint64_t rows = std::min(step, count - i * step);
+            ezlib::BufferReader chunk(starts[i], end - starts[i]);
+            ezlib::InternCache cache;
+            for (std::uint64_t row = 0; row < rows; ++row) {
+                std::uint64_t offset = chunk.position() - data;
+                std::uint32_t recordSize;
+                chunk.get(recordSize);
+                ezlib::BufferReader record(chunk.skip(recordSize), recordSize);
+                RowReader visit(record, floatFixed, cache);
+                T elem{};
+                T::fields(elem, visit);
+                part.append(elem, offset);
+            }
+        });
+    }
+
+    // Columnar blocks: rows, raw size, compressed size, compressed columns.
+    // Rows of a block share the block offset in the sidecar indexes. Every
+    // loader thread decodes a run of whole blocks.
+    void loadColumns(const char *data, ezlib::BufferReader &in,
+                     std::uint64_t count, bool floatFixed) {
+        struct Block {
+            std::uint64_t offset;
+            std::uint32_t rows, rawSize, packedSize;
+            const char *packed;
+        };
+        std::vector<Block> blocks;
+        std::uint64_t total = count;
+        while (count > 0) {
+            Block block;
+            block.offset = in.position() - data;
+            in.get(block.rows);
+            in.get(block.rawSize);
+            in.get(block.packedSize);
+            if (block.rows == 0 || block.rows > count) {
+                throw std::runtime_error("Table " + tableName +
+                                         " is corrupted");
+            }
+            block.packed = in.skip(block.packedSize);
+            blocks.push_back(block);
+            count -= block.rows;
+        }
+        std::size_t parts = std::min<std::size_t>(ezlib::workerCount(total),
+                                                  blocks.size());
+        std::size_t step = parts == 0 ? 0 : (blocks.size() + parts - 1) / parts;
+        loadParts(parts, [&](LoadPart &part, std::size_t i) {
+            ezlib::ColumnBlock block;
+            block.setSchema<T>(floatFixed);
+            std::size_t last = std::min(blocks.size(), (i + 1) * step);
+            for (std::size_t b = i * step; b < last; ++b) {
+                const Block &info = blocks[b];
+                std::string raw = ezlib::decompress(
+                    info.packed, info.packedSize, info.rawSize);
+                block.decode(raw.data(), raw.size(), info.rows);
+                for (std::uint32_t row = 0; row < info.rows; ++row) {
+                    T elem{};
+                    block.get(row, elem);
+                    part.append(elem, info.offset);
+                }
+            }
+        });
+    }
+
+    void load(const char *data, std::size_t size) {
+        Header header;
+        if (size < sizeof(Header)) {
+            throw std::runtime_error("Unknown format of table " + tableName);
+        }
+        std::memcpy(&header, data, sizeof(Header));
+        bool columns = std::memcmp(header.magic, "EZTC", 4) == 0;
+        if ((!columns && std::memcmp(header.magic, "EZTB", 4) != 0) ||
+            header.version < 1 || header.version > formatVersion) {
+            throw std::runtime_error("Unknown format of table " + tableName);
+        }
+        const char *body = data + sizeof(Header);
+        std::size_t bodySize = size - sizeof(Header);
+        if (ezlib::checksum(body, bodySize) != header.checksum) {
+            throw std::runtime_error("Table " + tableName + " is corrupted");
+        }
+
+        ezlib::BufferReader in(body, bodySize);
+        ordinals.reserve(header.count);
+        offsets.reserve(header.count);
+        bool floatFixed = header.version == 1;
+        if (columns) {
+            loadColumns(data, in, header.count, floatFixed);
+        } else {
+            loadRows(data, in, header.count, floatFixed);
+        }
+        length = header.count;
+        stamp = TableStamp{header.generation, header.checksum, header.count};
+    }
+
+    void saveRows(ezlib::BufferWriter &out, std::vector<T *> &records,
+                  std::vector<std::uint64_t> &newOffsets) {
+        auto put = [&out](const auto &value) { out.put(value); };
+        for (ezlib::Iterator<T> it = elements.begin(); it != elements.end();
+             ++it) {
+            newOffsets.push_back(out.size());
+            std::uint32_t recordSize = 0;
+            std::size_t sizePos = out.size();
+            out.put(recordSize);
+            T::fields(*it, put);
+            recordSize = out.size() - sizePos - sizeof(recordSize);
+            out.patch(sizePos, recordSize);
+            records.push_back(&*it);
+        }
+    }
+
+    void saveColumns(ezlib::BufferWriter &out, std::vector<T *> &records,
+                     std::vector<std::uint64_t> &newOffsets) {
+        ezlib::ColumnBlock block;
+        block.setSchema<T>();
+        auto flush = [&]() {
+            std::string raw = block.encode();
+            std::string packed = ezlib::compress(raw.data(), raw.size());
+            newOffsets.insert(newOffsets.end(), block.size(), out.size());
+            out.put(static_cast<std::uint32_t>(block.size()));
+            out.put(static_cast<std::uint32_t>(raw.size()));
+            out.put(static_cast<std::uint32_t>(packed.size()));
+            out.append(packed);
+            block.clear();
+        };
+        for (ezlib::Iterator<T> it = elements.begin(); it != elements.end();
+             ++it) {
+            block.add(*it);
+            records.push_back(&*it);
+            if (block.size() == blockRows) {
+                flush();
+            }
+        }
+        if (block.size() > 0) {
+            flush();
+        }
+    }
+
+    void save() {
+        ezlib::stats::ScopedTimer timer(ezlib::stats::TableSaveNs);
+        std::string data(sizeof(Header), '\0');
+        ezlib::BufferWriter out(data);
+        std::vector<T *> records;
+        std::vector<std::uint64_t> newOffsets;
+        records.reserve(length);
+        newOffsets.reserve(length);
+        if (format == TableFormat::Columns) {
+            saveColumns(out, records, newOffsets);
+        } else {
+            saveRows(out, records, newOffsets);
+        }
+
+        Header header{};
+        std::memcpy(header.magic,
+                    format == TableFormat::Columns ? "EZTC" : "EZTB", 4);
+        header.version = formatVersion;
+        header.generation = stamp.generation + 1;
+        header.count = records.size();
+        header.checksum = ezlib::checksum(data.data() + sizeof(Header),
+                                          data.size() - sizeof(Header));
+        std::memcpy(&data[0], &header, sizeof(Header));
+        if (!replaceFile(tableName, data)) {
+            return;
+        }
+
+        TableStamp saved{header.generation, header.checksum, header.count};
+        for (auto &index : indexes) {
+            index.second->write(saved, records, newOffsets);
+        }
+    }
+
+  public:
+    // Both formats are detected on load, `saveFormat` is what gets written.
+    ElemTable(const std::string &tableFile,
+              TableFormat saveFormat = TableFormat::Rows) {
+        isWrite = false;
+        tableName = tableFile;
+        format = saveFormat;
+        length = 0;
+        stamp = TableStamp{0, 0, 0};
+        ezlib::stats::ScopedTimer timer(ezlib::stats::TableLoadNs);
+        ezlib::MappedFile file;
+        if (file.open(tableName)) {
+            load(file.data(), file.size());
+        }
+    }
+
+    ~ElemTable() {
+        if (isWrite) {
+            save();
+        }
+    }
+
+    // Attaches the sidecar index "<table>.<name>.idx" for lookups through
+    // Compare, which must provide a static key(const T &). The sidecar is
+    // rebuilt only when it does not match the loaded data. Call before
+    // modifying the table.
+    template <typename Compare> void addIndex(const std::string &name) {
+        std::unique_ptr<KeyIndex<T>> index(
+            new KeyIndex<T>(tableName + "." + name + ".idx", [](const T &row) {
+                return encodeKey(Compare::key(row));
+            }));
+        if (!index->open(stamp, ordinals)) {
+            index->rebuild(stamp, ordinals, offsets);
+        }
+        indexes[std::type_index(typeid(Compare))] = std::move(index);
+    }
+
+    // Keeps the rows ordered by `field` in memory, for findRange/findBelow.
+    template <typename V> void addRangeIndex(V T::*field) {
+        std::unique_ptr<RangeIndex<T, V>> index(new RangeIndex<T, V>(field));
+        index->insertAll(elements.begin(), elements.end());
+        rowIndexes.push_back(std::move(index));
+    }
+
+    // Makes the given members searchable by prefix and substring, see
+    // search. Members listed first rank first.
+    void addTextIndex(const std::vector<ezlib::Interned T::*> &fields) {
+        std::unique_ptr<TextIndex<T>> index(new TextIndex<T>(fields));
+        index->insertAll(elements.begin(), elements.end());
+        rowIndexes.push_back(std::move(index));
+    }
+
+    // Keeps the rows sorted by Compare, see getLeaderboard.
+    template <typename Compare> void addLeaderboard() {
+        std::unique_ptr<Leaderboard<T, Compare>> board(
+            new Leaderboard<T, Compare>());
+        for (ezlib::Iterator<T> it = elements.begin(); it != elements.end();
+             ++it) {
+            board->insert(&*it);
+        }
+        rowIndexes.push_back(std::move(board));
+    }
+
+    template <typename Compare>
+    const Leaderboard<T, Compare> &getLeaderboard() {
+        for (auto &index : rowIndexes) {
+            auto board = dynamic_cast<Leaderboard<T, Compare> *>(index.get());
+            if (board != nullptr) {
+                return *board;
+            }
+        }
+        throw std::runtime_error("No leaderboard for this order");
+    }
+
+    // Rows with lo <= field <= hi, ordered by field.
+    template <typename V>
+    std::vector<const T *> findRange(V T::*field, const V &lo, const V &hi) {
+        return getRangeIndex(field).range(lo, hi);
+    }
+
+    // Rows with field < hi, ordered by field.
+    template <typename V>
+    std::vector<const T *> findBelow(V T::*field, const V &hi) {
+        return getRangeIndex(field).below(hi);
+    }
+
+    // Best matches for a partial text, see TextIndex::search.
+    std::vector<const T *> search(const std::string &query,
+                                  std::size_t limit) {
+        return getTextIndex().search(query, limit);
+    }
+
+    // Rows are handed out read-only; change them through updateRow.
+    template <typename Compare, typename K> const T &getRow(const K &key) {
+        ezlib::stats::add(ezlib::stats::TableLookups);
+        auto index = indexes.find(std::type_index(typeid(Compare)));
+        if (index != indexes.end()) {
+            T *row = index->second->find(encodeKey(key));
+            if (row == nullptr) {
+                ezlib::stats::add(ezlib::stats::TableMisses);
+                throw std::runtime_error("Not found");
+            }
+            return *row;
+        }
+        try {
+            return *elements.find_if_linear(key, Compare{});
+        } catch (const std::runtime_error &e) {
+            ezlib::stats::add(ezlib::stats::TableMisses);
+            throw;
+        }
+    }
+
+    const ezlib::LinkedList<T> &getElements() const { return elements; }
+    template <typename Compare, typename K>
+    void addOrUpdate(const T &row, const K &key) {
+        try {
+            updateRow(getRow<Compare>(key), row);
+        } catch (const std::runtime_error &e) {
+            addRow(row);
+        }
+    }
+
+    void addRow(const T &row) {
+        if (!isWrite) {
+            isWrite = true;
+        }
+        length++;
+        elements.push_back(row);
+        indexRow(&*(--elements.end()));
+    }
+
+    // Every change to a stored row has to go through here so the indexes
+    // stay in sync with it. `stored` is a row of this table, e.g. from
+    // getRow.
+    void updateRow(const T &stored, const T &value) {
+        T &row = const_cast<T &>(stored);
+        if (!isWrite) {
+            isWrite = true;
+        }
+        std::vector<std::pair<KeyIndex<T> *, std::string>> moved;
+        for (auto &index : indexes) {
+            std::string oldKey = index.second->key(row);
+            std::string newKey = index.second->key(value);
+            if (oldKey != newKey) {
+                index.second->erase(&row, oldKey);
+                moved.emplace_back(index.second.get(), newKey);
+            }
+        }
+        std::vector<RowIndex<T> *> movedRows;
+        for (auto &index : rowIndexes) {
+            if (index->differs(row, value)) {
+                index->erase(&row);
+                movedRows.push_back(index.get());
+            }
+        }
+        row = value;
+        for (auto &index : moved) {
+            index.first->insert(&row, index.second);
+        }
+        for (auto index : movedRows) {
+            index->insert(&row);
+        }
+    }
+
+    // Appends rows in one go, see LinkedList::append_range.
+    template <typename It> void addRows(It first, It last) {
+        ezlib::Iterator<T> it = elements.append_range(first, last);
+        for (; it != elements.end(); ++it) {
+            isWrite = true;
+            length++;
+            indexRow(&*it);
+        }
+    }
+
+    // Removes every row matching pred in a single pass, returns how many.
+    template <typename Pred> int removeIf(Pred pred) {
+        int removed = elements.erase_if([this, &pred](T &row) {
+            if (!pred(static_cast<const T &>(row))) {
+                return false;
+            }
+            unindexRow(&row);
+            return true;
+        });
+        if (removed > 0) {
+            isWrite = true;
+            length -= removed;
+        }
+        return removed;
+    }
+
+    // Removes the rows matching `key`. With a key index for Compare only
+    // those rows are visited, otherwise every row is.
+    template <typename Compare, typename K> int removeRow(const K &key) {
+        auto index = indexes.find(std::type_index(typeid(Compare)));
+        if (index == indexes.end()) {
+            Compare comp{};
+            return removeIf(
+                [&comp, &key](const T &row) { return comp(row, key); });
+        }
+        std::vector<T *> rows = index->second->findAll(encodeKey(key));
+        for (T *row : rows) {
+            unindexRow(row);
+            elements.erase(elements.iterator_to(row));
+        }
+        if (!rows.empty()) {
+            isWrite = true;
+            length -= static_cast<int>(rows.size());
+        }
+        return static_cast<int>(rows.size());
+    }
+
+    int getLength() { return length; }
+
+    // Changes made so far will not be written back to the file.
+    void discardChanges() { isWrite = false; }
+
+    // Rows, their list nodes and the indexes that count their heap;
+    // interned strings are accounted by ezlib::StringPool. The peak adds
+    // up peaks reached at different times, so it is an upper bound.
+    ezlib::MemoryAccount getMemory() const {
+        ezlib::MemoryAccount ret = elements.getMemory();
+        for (const auto &index : rowIndexes) {
+            ezlib::MemoryAccount part = index->getMemory();
+            ret.live += part.live;
+            ret.peak += part.peak;
+            ret.allocations += part.allocations;
+        }
+        return ret;
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace ezlib {
+
+// Decimal fixed point number kept as a whole count of 1/Scale parts, so sums
+// and comparisons are exact. Scale is a power of ten; Tag keeps quantities of
+// different kinds (money, weight) from mixing.
+template <typename Tag, std::int64_t Scale> class Fixed {
+  private:
+    std::int64_t count;
+
+    static constexpr int decimals() {
+        int ret = 0;
+        for (std::int64_t s = Scale; s > 1; s /= 10) {
+            ++ret;
+        }
+        return ret;
+    }
+
+  public:
+    static constexpr std::int64_t scale = Scale;
+
+    constexpr Fixed() : count(0) {}
+
+    static constexpr Fixed fromMinor(std::int64_t minor) {
+        Fixed ret;
+        ret.count = minor;
+        return ret;
+    }
+    // Nearest value to `value` whole units, for numbers stored as floats.
+    static Fixed fromDouble(double value) {
+        return fromMinor(std::llround(value * Scale));
+    }
+
+    // Reads "12", "-0.5" or "3.14159"; digits past the scale are rounded.
+    static Fixed parse(const std::string &text) {
+        std::size_t pos = 0;
+        bool negative = false;
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+            negative = text[pos++] == '-';
+        }
+        std::int64_t whole = 0, fraction = 0;
+        int digits = 0, wholeDigits = 0;
+        bool point = false, roundUp = false;
+        for (; pos < text.size(); ++pos) {
+            char c = text[pos];
+            if (c == '.' && !point) {
+                point = true;
+                continue;
+            }
+            if (c < '0' || c > '9') {
+                throw std::invalid_argument("Not a number: " + text);
+            }
+            if (!point) {
+                if (++wholeDigits > 15) {
+                    throw std::invalid_argument("Number too large: " + text);
+                }
+                whole = whole * 10 + (c - '0');
+            } else if (digits < decimals()) {
+                fraction = fraction * 10 + (c - '0');
+                ++digits;
+            } else if (digits++ == decimals()) {
+                roundUp = c >= '5';
+            }
+        }
+        if (wholeDigits == 0 && digits == 0) {
+            throw std::invalid_argument("Not a number: " + text);
+        }
+        for (; digits < decimals(); ++digits) {
+            fraction *= 10;
+        }
+        std::int64_t minor = whole * Scale + fraction + roundUp;
+        return fromMinor(negative ? -minor : minor);
+    }
+
+    constexpr std::int64_t minor() const { return count; }
+    double toDouble() const { return static_cast<double>(count) / Scale; }
+
+    // Whole units, a point and all the decimals, e.g. "1.250".
+    std::string str() const {
+        std::uint64_t magnitude =
+            count < 0 ? 0 - static_cast<std::uint64_t>(count) : count;
+        std::string fraction = std::to_string(magnitude % Scale);
+        fraction.insert(0, decimals() - static_cast<int>(fraction.size()),
+                        '0');
+        return (count < 0 ? "-" : "") + std::to_string(magnitude / Scale) +
+               "." + fraction;
+    }
+
+    Fixed &operator+=(Fixed other) {
+        count += other.count;
+        return *this;
+    }
+    Fixed &operator-=(Fixed other) {
+        count -= other.count;
+        return *this;
+    }
+    friend Fixed operator+(Fixed lhs, Fixed rhs) { return lhs += rhs; }
+    friend Fixed operator-(Fixed lhs, Fixed rhs) { return lhs -= rhs; }
+    friend Fixed operator-(Fixed value) { return fromMinor(-value.count); }
+
+    friend constexpr bool operator==(Fixed lhs, Fixed rhs) {
+        return lhs.count == rhs.count;
+    }
+    friend constexpr bool operator!=(Fixed lhs, Fixed rhs) {
+        return lhs.count != rhs.count;
+    }
+    friend constexpr bool operator<(Fixed lhs, Fixed rhs) {
+        return lhs.count < rhs.count;
+    }
+    friend constexpr bool operator>(Fixed lhs, Fixed rhs) {
+        return lhs.count > rhs.count;
+    }
+    friend constexpr bool operator<=(Fixed lhs, Fixed rhs) {
+        return lhs.count <= rhs.count;
+    }
+    friend constexpr bool operator>=(Fixed lhs, Fixed rhs) {
+        return lhs.count >= rhs.count;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, Fixed value) {
+        return os << value.str();
+    }
+};
+
+struct MoneyTag {};
+struct WeightTag {};
+
+// Amounts of money in minor units (cents).
+using Money = Fixed<MoneyTag, 100>;
+// Weights in grams, written in kilograms.
+using Weight = Fixed<WeightTag, 1000>;
+
+// What `weight` costs at `perKg`, to the nearest minor unit.
+inline Money priceOf(Weight weight, Money perKg) {
+    std::int64_t product = weight.minor() * perKg.minor();
+    std::int64_t half = Weight::scale / 2;
+    return Money::fromMinor(product >= 0 ? (product + half) / Weight::scale
+                                         : (product - half) / Weight::scale);
+}
+
+// Sum of priceOf(Weight::fromMinor(weights[i]), Money::fromMinor(perKg[i]))
+// over `count` items, with the same rounding per item. The loop has no
+// branches, so compilers vectorize it on targets with 64-bit vector
+// multiplies and int64/double conversions (AVX-512DQ). The quotient is
+// estimated in double and then corrected, which is exact while a product
+// stays below 2^52; batches with larger ones are summed through priceOf.
+inline Money totalPrice(const std::int64_t *weights,
+                        const std::int64_t *perKg, std::size_t count) {
+    const std::int64_t scale = Weight::scale;
+    const std::int64_t limit = std::int64_t(1) << 52;
+    std::int64_t sum = 0, outOfRange = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int64_t product = weights[i] * perKg[i];
+        std::int64_t negative = product < 0;
+        // Rounded half away from zero, then truncated.
+        std::int64_t biased = product + scale / 2 - scale * negative;
+        outOfRange |= (biased > limit) | (biased < -limit);
+        auto quotient = static_cast<std::int64_t>(
+            static_cast<double>(biased) * (1.0 / scale));
+        std::int64_t rest = biased - quotient * scale;
+        quotient += (rest >= scale) - (rest <= -scale) -
+                    ((1 - negative) & (rest < 0)) + (negative & (rest > 0));
+        sum += quotient;
+    }
+    if (outOfRange != 0) {
+        Money ret;
+        for (std::size_t i = 0; i < count; ++i) {
+            ret += priceOf(Weight::fromMinor(weights[i]),
+                           Money::fromMinor(perKg[i]));
+        }
+        return ret;
+    }
+    return Money::fromMinor(sum);
+}
+
+} // namespace ezlib
+
+#endif
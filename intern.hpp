@@ -0,0 +1,288 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "memory.hpp"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ezlib {
+
+// Set of distinct strings, each with the number of Interned handles to it.
+// A string is freed when its last handle goes away; until then its address
+// stays valid. The strings are spread over shards by hash, each with its own
+// lock, so threads loading tables rarely wait for each other.
+class StringPool {
+  public:
+    using Entry = std::pair<const std::string, std::atomic<std::size_t>>;
+
+  private:
+    using Map = std::unordered_map<std::string, std::atomic<std::size_t>,
+                                   std::hash<std::string>,
+                                   std::equal_to<std::string>,
+                                   CountingAllocator<Entry>>;
+
+    static constexpr std::size_t shardCount = 32;
+
+    struct alignas(64) Shard {
+        mutable std::mutex lock;
+        MemoryAccount memory;
+        Map strings;
+        std::size_t bytes = 0;
+
+        Shard()
+            : strings(0, std::hash<std::string>(),
+                      std::equal_to<std::string>(),
+                      CountingAllocator<Entry>(&memory)) {}
+
+        // Call with the lock held.
+        Entry *acquire(const std::string &str) {
+            auto found = strings.find(str);
+            if (found != strings.end()) {
+                found->second.fetch_add(1, std::memory_order_relaxed);
+                return &*found;
+            }
+            auto inserted = strings.emplace(std::piecewise_construct,
+                                            std::forward_as_tuple(str),
+                                            std::forward_as_tuple(1));
+            bytes += str.size();
+            std::size_t extra = extraBytes(inserted.first->first);
+            if (extra > 0) {
+                memory.allocate(extra);
+            }
+            return &*inserted.first;
+        }
+    };
+
+    Shard shards[shardCount];
+
+    // Characters outside the small string buffer live in their own
+    // allocation, which the map's allocator does not see.
+    static std::size_t extraBytes(const std::string &str) {
+        std::size_t capacity = str.capacity();
+        return capacity > std::string().capacity() ? capacity + 1 : 0;
+    }
+
+    static std::size_t shardOf(const std::string &str) {
+        return std::hash<std::string>()(str) % shardCount;
+    }
+
+  public:
+    static StringPool &global() {
+        static StringPool pool;
+        return pool;
+    }
+
+    // The entry of `str`, with one more reference.
+    Entry *acquire(const std::string &str) {
+        Shard &shard = shards[shardOf(str)];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        return shard.acquire(str);
+    }
+
+    // acquire() for every non-empty string of `strs`, taking the lock of
+    // each shard once. Empty strings get nullptr.
+    void acquireAll(const std::vector<std::string> &strs,
+                    std::vector<Entry *> &entries) {
+        std::vector<unsigned char> where(strs.size());
+        bool used[shardCount] = {};
+        for (std::size_t i = 0; i < strs.size(); ++i) {
+            where[i] = static_cast<unsigned char>(shardOf(strs[i]));
+            used[where[i]] = !strs[i].empty() || used[where[i]];
+        }
+        entries.assign(strs.size(), nullptr);
+        for (std::size_t s = 0; s < shardCount; ++s) {
+            if (!used[s]) {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(shards[s].lock);
+            for (std::size_t i = 0; i < strs.size(); ++i) {
+                if (where[i] == s && !strs[i].empty()) {
+                    entries[i] = shards[s].acquire(strs[i]);
+                }
+            }
+        }
+    }
+
+    // Drops a reference taken by acquire() or by copying a handle. The last
+    // one is dropped under the lock, so acquire() cannot revive the entry
+    // while it is being erased.
+    void release(Entry *entry) {
+        std::size_t refs = entry->second.load(std::memory_order_relaxed);
+        while (refs > 1) {
+            if (entry->second.compare_exchange_weak(
+                    refs, refs - 1, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+        Shard &shard = shards[shardOf(entry->first)];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (entry->second.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        shard.bytes -= entry->first.size();
+        shard.memory.release(extraBytes(entry->first));
+        shard.strings.erase(entry->first);
+    }
+
+    std::size_t size() const {
+        std::size_t ret = 0;
+        for (const Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            ret += shard.strings.size();
+        }
+        return ret;
+    }
+
+    // Sum over the shards; the peak adds peaks reached at different times,
+    // so it is an upper bound.
+    MemoryAccount getMemory() const {
+        MemoryAccount ret;
+        for (const Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            ret.live += shard.memory.live;
+            ret.peak += shard.memory.peak;
+            ret.allocations += shard.memory.allocations;
+        }
+        return ret;
+    }
+
+    // Characters held by the pool, not counting per-string overhead.
+    std::size_t byteSize() const {
+        std::size_t ret = 0;
+        for (const Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            ret += shard.bytes;
+        }
+        return ret;
+    }
+};
+
+// Pointer sized handle to a string in the global pool. Two handles are equal
+// exactly when they point to the same pooled string, so comparing them does
+// not look at the characters. The empty string is not pooled.
+class Interned {
+  private:
+    StringPool::Entry *entry;
+
+    static const std::string &emptyString() {
+        static const std::string empty;
+        return empty;
+    }
+
+    static StringPool::Entry *acquire(const std::string &str) {
+        return str.empty() ? nullptr : StringPool::global().acquire(str);
+    }
+
+    explicit Interned(StringPool::Entry *acquired) : entry(acquired) {}
+
+  public:
+    Interned() : entry(nullptr) {}
+    Interned(const std::string &str) : entry(acquire(str)) {}
+    Interned(const char *str) : Interned(std::string(str)) {}
+    Interned(const Interned &other) : entry(other.entry) {
+        if (entry != nullptr) {
+            entry->second.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    Interned(Interned &&other) noexcept : entry(other.entry) {
+        other.entry = nullptr;
+    }
+    ~Interned() {
+        if (entry != nullptr) {
+            StringPool::global().release(entry);
+        }
+    }
+
+    Interned &operator=(Interned other) noexcept {
+        std::swap(entry, other.entry);
+        return *this;
+    }
+
+    // Handles to all of `strs`, in order, through StringPool::acquireAll.
+    static void internAll(const std::vector<std::string> &strs,
+                          std::vector<Interned> &handles) {
+        std::vector<StringPool::Entry *> entries;
+        handles.clear();
+        handles.reserve(strs.size());
+        StringPool::global().acquireAll(strs, entries);
+        for (StringPool::Entry *acquired : entries) {
+            handles.push_back(Interned(acquired));
+        }
+    }
+
+    operator const std::string &() const { return str(); }
+    const std::string &str() const {
+        return entry != nullptr ? entry->first : emptyString();
+    }
+    std::size_t size() const { return str().size(); }
+    bool empty() const { return entry == nullptr; }
+
+    friend bool operator==(const Interned &lhs, const Interned &rhs) {
+        return lhs.entry == rhs.entry;
+    }
+    friend bool operator!=(const Interned &lhs, const Interned &rhs) {
+        return lhs.entry != rhs.entry;
+    }
+    friend bool operator==(const Interned &lhs, const std::string &rhs) {
+        return lhs.str() == rhs;
+    }
+    friend bool operator==(const std::string &lhs, const Interned &rhs) {
+        return lhs == rhs.str();
+    }
+    friend bool operator!=(const Interned &lhs, const std::string &rhs) {
+        return lhs.str() != rhs;
+    }
+    friend bool operator!=(const std::string &lhs, const Interned &rhs) {
+        return lhs != rhs.str();
+    }
+    friend bool operator<(const Interned &lhs, const Interned &rhs) {
+        return lhs.entry != rhs.entry && lhs.str() < rhs.str();
+    }
+    friend std::ostream &operator<<(std::ostream &os, const Interned &str) {
+        return os << str.str();
+    }
+};
+
+// Handles one loader thread has already taken, so values repeated over many
+// rows (a few dozen manufacturers) do not go to the pool every time. Keeps
+// the first `limit` distinct strings, later ones always go to the pool.
+class InternCache {
+  private:
+    std::unordered_map<std::string, Interned> handles;
+    std::size_t limit;
+
+  public:
+    explicit InternCache(std::size_t maxSize = 4096) : limit(maxSize) {}
+
+    Interned get(const std::string &str) {
+        auto found = handles.find(str);
+        if (found != handles.end()) {
+            return found->second;
+        }
+        Interned ret(str);
+        if (handles.size() < limit) {
+            handles.emplace(str, ret);
+        }
+        return ret;
+    }
+};
+
+} // namespace ezlib
+
+namespace std {
+template <> struct hash<ezlib::Interned> {
+    std::size_t operator()(const ezlib::Interned &str) const {
+        return std::hash<const std::string *>()(&str.str());
+    }
+};
+} // namespace std
+
+#endif
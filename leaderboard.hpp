@@ -0,0 +1,59 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "orderTree.hpp"
+#include "rangeIndex.hpp"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Rows of a table kept sorted by Compare (e.g. Revenue::RevenueSort), so the
+// sorted listing and the rank of a row are available without sorting.
+template <typename T, typename Compare> class Leaderboard : public RowIndex<T> {
+  private:
+    // Rows that compare equal are ordered by address to keep keys unique.
+    struct RowLess {
+        Compare comp;
+
+        bool operator()(const T *lhs, const T *rhs) const {
+            if (comp(*lhs, *rhs)) {
+                return true;
+            }
+            if (comp(*rhs, *lhs)) {
+                return false;
+            }
+            return std::less<const T *>()(lhs, rhs);
+        }
+    };
+
+    ezlib::OrderTree<const T *, RowLess> rows;
+
+  public:
+    void insert(T *row) override { rows.insert(row); }
+
+    void erase(T *row) override { rows.erase(row); }
+
+    bool differs(const T &from, const T &to) const override {
+        Compare comp;
+        return comp(from, to) || comp(to, from);
+    }
+
+    std::size_t size() const { return rows.size(); }
+
+    // 1-based position of `row`.
+    std::size_t rank(const T *row) const { return rows.rank(row) + 1; }
+
+    const T *at(std::size_t pos) const { return rows.at(pos); }
+
+    std::vector<const T *> top(std::size_t count) const {
+        std::vector<const T *> ret;
+        for (std::size_t i = 0; i < count && i < rows.size(); ++i) {
+            ret.push_back(rows.at(i));
+        }
+        return ret;
+    }
+
+    template <typename F> void forEach(F f) const { rows.forEach(f); }
+};
+
+#endif
@@ -1,11 +1,19 @@
 #ifndef LINKEDLIST_H
 #define LINKEDLIST_H
 
+#include "memory.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace ezlib {
 
@@ -18,42 +26,95 @@ template <class T> class LinkedList {
         std::shared_ptr<T> data;
         Node *prev = nullptr;
         Node *next = nullptr;
+        // Where the node was allocated, it may have been spliced in from
+        // another list.
+        MemoryAccount *account = nullptr;
 
         explicit Node(T value) { data = std::make_shared<T>(value); }
+        explicit Node(std::shared_ptr<T> value) : data(std::move(value)) {}
         Node() {}
     };
 
+  private:
+    // Payload of a node made by the list, with a pointer back to the node so
+    // iterator_to can find it from the element's address.
+    struct Slot {
+        T value;
+        Node *node = nullptr;
+
+        explicit Slot(const T &v) : value(v) {}
+    };
+
+  public:
     std::shared_ptr<Node *> pbeg;
     std::shared_ptr<Node *> pend;
 
     int size;
 
-    LinkedList<T>() noexcept {
+    LinkedList<T>() {
         pbeg = std::make_shared<Node *>();
         pend = std::make_shared<Node *>(new Node);
         *pbeg = *pend;
         size = 0;
+        accounts.emplace_back(new MemoryAccount);
     }
 
-    ~LinkedList<T>() noexcept { clear(); }
+    LinkedList(const LinkedList &) = delete;
+    LinkedList &operator=(const LinkedList &) = delete;
+
+    ~LinkedList<T>() noexcept {
+        clear();
+        delete *pend;
+    }
 
     class Iterator;
+    class ConstIterator;
 
     Iterator begin() { return Iterator(*pbeg); }
 
     Iterator end() { return Iterator(*pend); }
 
+    ConstIterator begin() const { return ConstIterator(*pbeg); }
+
+    ConstIterator end() const { return ConstIterator(*pend); }
+
+    // Nodes and payloads held by this list, including those spliced in.
+    // The peak is the most this list held at once, not counting what
+    // spliced lists held before they were spliced.
+    MemoryAccount getMemory() const {
+        MemoryAccount ret;
+        for (const auto &account : accounts) {
+            ret.live += account->live;
+            ret.allocations += account->allocations;
+        }
+        ret.peak = peakLive;
+        return ret;
+    }
+
     void push_back(const T &data);
-    template <typename K = T> void remove(const K &key);
+    // Copies [first, last) to the end and returns the first new element.
+    // The copies are linked in at once, after all of them are made.
+    template <typename It> Iterator append_range(It first, It last);
+    // Moves all nodes of `other` before `pos` in O(1), leaving it empty.
+    void splice(Iterator pos, LinkedList &other);
+    // Removes the element at `pos`, returns the one after it.
+    Iterator erase(Iterator pos);
+    // The position of `value`, an element of this list, in O(1).
+    Iterator iterator_to(T *value) {
+        static_assert(std::is_standard_layout<T>::value,
+                      "iterator_to needs the element first in its Slot");
+        return Iterator(reinterpret_cast<Slot *>(value)->node);
+    }
+    // Removes every element matching pred in one pass, returns how many.
+    template <typename Pred> int erase_if(Pred pred);
+    template <typename K = T> int remove(const K &key);
     template <typename Compare, typename K>
-    void remove(const K &key, const Compare &comp) {
-        for (auto it = begin(); it != end(); ++it) {
-            if (comp(*it, key)) {
-                _delNode(it.currentNode);
-                --size;
-            }
-        }
+    int remove(const K &key, const Compare &comp) {
+        return erase_if([&key, &comp](const T &elem) {
+            return comp(elem, key);
+        });
     }
+    // Stable. Relinks the nodes, so every element keeps its address.
     template <typename Compare = std::less<T>> void sort(Compare comp);
     void sort();
     template <typename K = T>
@@ -115,56 +176,71 @@ template <class T> class LinkedList {
                     counter++;
                 }
             }
+            stats::add(stats::ListNodeHops, counter);
 
             return counter;
         }
 
         Iterator operator-(int n) {
             Iterator tmp(*this);
+            int hops = 0;
             for (; n > 0; n--) {
                 if (tmp.currentNode->prev != nullptr) {
                     tmp.currentNode = tmp.currentNode->prev;
+                    hops++;
                 } else {
                     break;
                 }
             }
+            stats::add(stats::ListNodeHops, hops);
             return tmp;
         }
 
         Iterator operator+(int n) {
             Iterator tmp(*this);
+            int hops = 0;
             for (; n > 0; n--) {
                 if (tmp.currentNode->next != nullptr) {
                     tmp.currentNode = tmp.currentNode->next;
+                    hops++;
                 } else {
                     break;
                 }
             }
+            stats::add(stats::ListNodeHops, hops);
             return tmp;
         }
 
         Iterator &operator+=(int n) {
+            int hops = 0;
             for (; n > 0; n--) {
                 if (currentNode->next != nullptr) {
                     currentNode = currentNode->next;
+                    hops++;
                 } else {
                     break;
                 }
             }
+            stats::add(stats::ListNodeHops, hops);
             return *this;
         }
 
         Iterator &operator-=(int n) {
+            int hops = 0;
             for (; n > 0; n--) {
                 if (currentNode->prev != nullptr) {
                     currentNode = currentNode->prev;
+                    hops++;
                 } else {
                     break;
                 }
             }
+            stats::add(stats::ListNodeHops, hops);
             return *this;
         }
 
+        // Exchanges the values of two elements, not their nodes, which
+        // breaks any index holding their addresses.
         Iterator &swap(Iterator &it) {
             T temp = *(currentNode->data);
             *(currentNode->data) = *(it.currentNode->data);
@@ -185,7 +261,76 @@ template <class T> class LinkedList {
         }
     };
 
+    // Read-only forward iterator, for lists handed out as const.
+    class ConstIterator {
+      private:
+        const Node *currentNode;
+
+      public:
+        ConstIterator() : currentNode(nullptr) {}
+        explicit ConstIterator(const Node *node) : currentNode(node) {}
+
+        ConstIterator &operator++() {
+            if (currentNode)
+                currentNode = currentNode->next;
+            return *this;
+        }
+
+        ConstIterator operator++(int) {
+            ConstIterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        const T &operator*() const { return *(currentNode->data); }
+
+        const T *operator->() const { return &*(currentNode->data); }
+
+        bool operator!=(const ConstIterator &it) const {
+            return currentNode != it.currentNode;
+        }
+
+        bool operator==(const ConstIterator &it) const {
+            return currentNode == it.currentNode;
+        }
+    };
+
   private:
+    // Payloads keep a pointer to the account they were allocated from, so
+    // the accounts of spliced lists move along with their nodes. The first
+    // one is this list's own.
+    std::vector<std::unique_ptr<MemoryAccount>> accounts;
+    std::size_t peakLive = 0;
+
+    // Memory only grows on new nodes and splices, which call this.
+    void notePeak() {
+        std::size_t live = 0;
+        for (const auto &account : accounts) {
+            live += account->live;
+        }
+        peakLive = std::max(peakLive, live);
+    }
+
+    Node *_newNode(const T &data) {
+        // The node and its shared payload.
+        stats::add(stats::ListAllocations, 2);
+        MemoryAccount *account = accounts.front().get();
+        std::shared_ptr<Slot> slot =
+            std::allocate_shared<Slot>(CountingAllocator<Slot>(account), data);
+        Node *n = CountingAllocator<Node>(account).allocate(1);
+        new (n) Node(std::shared_ptr<T>(slot, &slot->value));
+        n->account = account;
+        slot->node = n;
+        notePeak();
+        return n;
+    }
+
+    void _freeNode(Node *node) {
+        MemoryAccount *account = node->account;
+        node->~Node();
+        CountingAllocator<Node>(account).deallocate(node, 1);
+    }
+
     void _delNode(Node *node) {
         if (node == *pbeg) {
             *pbeg = node->next;
@@ -195,8 +340,23 @@ template <class T> class LinkedList {
             (node->next)->prev = node->prev;
         }
     }
+
+    // Links the chain first..last, `count` nodes long, before `at`.
+    void _link(Node *at, Node *first, Node *last, int count) {
+        first->prev = at->prev;
+        if (at->prev == nullptr) {
+            *pbeg = first;
+        } else {
+            at->prev->next = first;
+        }
+        last->next = at;
+        at->prev = last;
+        size += count;
+    }
 };
 template <typename T> using Iterator = typename LinkedList<T>::Iterator;
+template <typename T>
+using ConstIterator = typename LinkedList<T>::ConstIterator;
 
 template <typename T, typename K = T>
 Iterator<T> lower_bound(Iterator<T> begin, Iterator<T> end, const K &key) {
@@ -204,11 +364,13 @@ Iterator<T> lower_bound(Iterator<T> begin, Iterator<T> end, const K &key) {
     --end;
     int count = end - begin;
     int step;
+    int comparisons = 0;
     while (count > 0) {
         it = begin;
         step = count / 2;
         it += step;
 
+        comparisons++;
         if (*it < key) {
             begin = ++it;
             count -= step + 1;
@@ -216,6 +378,7 @@ Iterator<T> lower_bound(Iterator<T> begin, Iterator<T> end, const K &key) {
             count = step;
         }
     }
+    stats::add(stats::ListComparisons, comparisons);
     return begin;
 }
 
@@ -226,11 +389,13 @@ Iterator<T> lower_bound(Iterator<T> begin, Iterator<T> end, const K &key,
     --end;
     int count = end - begin;
     int step;
+    int comparisons = 0;
     while (count > 0) {
         it = begin;
         step = count / 2;
         it += step;
 
+        comparisons++;
         if (comp(*it, key)) {
             begin = ++it;
             count -= step + 1;
@@ -238,6 +403,7 @@ Iterator<T> lower_bound(Iterator<T> begin, Iterator<T> end, const K &key,
             count = step;
         }
     }
+    stats::add(stats::ListComparisons, comparisons);
     return begin;
 }
 
@@ -247,11 +413,13 @@ Iterator<T> upper_bound(Iterator<T> begin, Iterator<T> end, const K &key) {
     --end;
     int count = end - begin;
     int step;
+    int comparisons = 0;
     while (count > 0) {
         it = begin;
         step = count / 2;
         it += step;
 
+        comparisons++;
         if (!(key < *it)) {
             begin = ++it;
             count -= step + 1;
@@ -259,6 +427,7 @@ Iterator<T> upper_bound(Iterator<T> begin, Iterator<T> end, const K &key) {
             count = step;
         }
     }
+    stats::add(stats::ListComparisons, comparisons);
     return begin;
 }
 
@@ -269,11 +438,13 @@ Iterator<T> upper_bound(Iterator<T> begin, Iterator<T> end, const K &key,
     --end;
     int count = end - begin;
     int step;
+    int comparisons = 0;
     while (count > 0) {
         it = begin;
         step = count / 2;
         it += step;
 
+        comparisons++;
         if (!comp(key, *it)) {
             begin = ++it;
             count -= step + 1;
@@ -281,17 +452,16 @@ Iterator<T> upper_bound(Iterator<T> begin, Iterator<T> end, const K &key,
             count = step;
         }
     }
+    stats::add(stats::ListComparisons, comparisons);
     return begin;
 }
 
 template <typename T> void LinkedList<T>::clear() {
-    Iterator it = begin();
-    Iterator it_s;
-    while (it != end() && size != 0) {
-        it_s = it;
-        ++it;
-        _delNode(it_s.currentNode);
-        // it_s.currentNode->del();
+    Node *node = *pbeg;
+    while (node != *pend) {
+        Node *next = node->next;
+        _freeNode(node);
+        node = next;
     }
     (*pend)->prev = nullptr;
     *pbeg = *pend;
@@ -299,49 +469,127 @@ template <typename T> void LinkedList<T>::clear() {
 }
 
 template <typename T> void LinkedList<T>::push_back(const T &data) {
-    Node *n = new Node(data);
-    if (*pbeg == *pend) {
-        *pbeg = n;
-        (*pbeg)->next = *pend;
-        (*pend)->prev = n;
-    } else {
-        n->next = *pend;
-        n->prev = (*pend)->prev;
-        (*pend)->prev->next = n;
-        (*pend)->prev = n;
+    Node *n = _newNode(data);
+    _link(*pend, n, n, 1);
+}
+
+template <typename T>
+template <typename It>
+typename LinkedList<T>::Iterator LinkedList<T>::append_range(It first,
+                                                              It last) {
+    Node *head = nullptr;
+    Node *tail = nullptr;
+    int count = 0;
+    try {
+        for (; first != last; ++first, ++count) {
+            Node *n = _newNode(*first);
+            n->prev = tail;
+            if (tail == nullptr) {
+                head = n;
+            } else {
+                tail->next = n;
+            }
+            tail = n;
+        }
+    } catch (...) {
+        while (head != nullptr) {
+            Node *next = head->next;
+            _freeNode(head);
+            head = next;
+        }
+        throw;
+    }
+    if (head == nullptr) {
+        return end();
     }
-    size++;
+    _link(*pend, head, tail, count);
+    return Iterator(head);
 }
 
 template <typename T>
-template <typename K>
-void LinkedList<T>::remove(const K &key) {
-    // Iterator it = lower_bound<T, K>(begin(), end(), key);
-    // if (it != end()) {
-    //     it.currentNode->del();
-    //     size--;
-    // } else {
-    //     throw std::runtime_error("Nothing found");
-    // }
-    for (auto it = begin(); it != end(); ++it) {
-        if (*it == key) {
-            _delNode(it.currentNode);
-            // it.currentNode->del();
-            --size;
+void LinkedList<T>::splice(Iterator pos, LinkedList &other) {
+    if (&other == this || other.size == 0) {
+        return;
+    }
+    Node *first = *other.pbeg;
+    Node *last = (*other.pend)->prev;
+    *other.pbeg = *other.pend;
+    (*other.pend)->prev = nullptr;
+
+    _link(pos.currentNode, first, last, other.size);
+    other.size = 0;
+
+    for (auto &account : other.accounts) {
+        accounts.push_back(std::move(account));
+    }
+    other.accounts.clear();
+    other.accounts.emplace_back(new MemoryAccount);
+    other.peakLive = 0;
+    notePeak();
+}
+
+template <typename T>
+typename LinkedList<T>::Iterator LinkedList<T>::erase(Iterator pos) {
+    if (pos.currentNode == *pend) {
+        throw std::runtime_error("Cannot erase end()");
+    }
+    Node *next = pos.currentNode->next;
+    _delNode(pos.currentNode);
+    _freeNode(pos.currentNode);
+    --size;
+    return Iterator(next);
+}
+
+template <typename T>
+template <typename Pred>
+int LinkedList<T>::erase_if(Pred pred) {
+    int removed = 0;
+    for (Iterator it = begin(); it != end();) {
+        if (pred(*it)) {
+            it = erase(it);
+            removed++;
+        } else {
+            ++it;
         }
     }
+    return removed;
+}
+
+template <typename T>
+template <typename K>
+int LinkedList<T>::remove(const K &key) {
+    return erase_if([&key](const T &elem) { return elem == key; });
 }
 
 template <typename T>
 template <typename Compare>
 void LinkedList<T>::sort(Compare comp) {
-    for (Iterator i = begin(); i != end(); ++i) {
-        for (Iterator j = begin(); j != i; ++j) {
-            if (comp(*i, *j)) {
-                i.swap(j);
-            }
+    std::vector<Node *> nodes;
+    nodes.reserve(size);
+    for (Node *node = *pbeg; node != *pend; node = node->next) {
+        nodes.push_back(node);
+    }
+    std::uint64_t comparisons = 0;
+    std::stable_sort(nodes.begin(), nodes.end(),
+                     [&comp, &comparisons](const Node *lhs, const Node *rhs) {
+                         comparisons++;
+                         return comp(*lhs->data, *rhs->data);
+                     });
+    Node *prev = nullptr;
+    for (Node *node : nodes) {
+        node->prev = prev;
+        if (prev == nullptr) {
+            *pbeg = node;
+        } else {
+            prev->next = node;
         }
+        prev = node;
+    }
+    if (prev != nullptr) {
+        prev->next = *pend;
+        (*pend)->prev = prev;
     }
+    stats::add(stats::ListComparisons, comparisons);
 }
 
 template <typename T> void LinkedList<T>::sort() {
@@ -361,7 +609,7 @@ std::pair<Iterator<T>, Iterator<T>> LinkedList<T>::find_range(const K &key) {
 
 template <typename T>
 template <typename K>
-Iterator<T> LinkedList<T>::find(const K &key) {
+typename LinkedList<T>::Iterator LinkedList<T>::find(const K &key) {
     auto lower = lower_bound<T, K>(begin(), end(), key);
     if (lower == --end()) {
         throw std::runtime_error("Not found");
@@ -371,7 +619,8 @@ Iterator<T> LinkedList<T>::find(const K &key) {
 
 template <typename T>
 template <typename K, typename Compare>
-Iterator<T> LinkedList<T>::find_if(const K &key, Compare comp) {
+typename LinkedList<T>::Iterator LinkedList<T>::find_if(const K &key,
+                                                         Compare comp) {
     auto lower = lower_bound<T, K, Compare>(begin(), end(), key, comp);
     if (lower == --end()) {
         throw std::runtime_error("Not found");
@@ -381,7 +630,8 @@ Iterator<T> LinkedList<T>::find_if(const K &key, Compare comp) {
 
 template <typename T>
 template <typename K, typename Compare>
-Iterator<T> LinkedList<T>::find_if_linear(const K &key, const Compare &comp) {
+typename LinkedList<T>::Iterator
+LinkedList<T>::find_if_linear(const K &key, const Compare &comp) {
     if (size == 0) {
         throw std::runtime_error("List is empty!");
     }
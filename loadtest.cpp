@@ -0,0 +1,543 @@
+// Generates shop datasets and replays a mix of operations against them.
+//
+//   loadtest generate --products N [--revenue M] [--dir D] [--seed S]
+//   loadtest run [--threads N] [--ops N] [--dir D] [--seed S] [--save]
+//                [--mix lookup=60,add=10,edit=15,remove=1,sell=14]
+//                [--connect SOCKET [--pipeline N]]
+//
+// With --connect every thread is a client of a `cursach --serve` process
+// working on the dataset in --dir. With --pipeline every client sends N
+// requests before reading their responses.
+#include "elemTable.hpp"
+#include "records.hpp"
+#include "shop.hpp"
+#include "table.hpp"
+#ifdef __linux__
+#include "shopServer.hpp"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Samples 0..n-1 with probability proportional to 1 / (i + 1)^s.
+class Zipf {
+  private:
+    std::vector<double> cdf;
+
+  public:
+    Zipf(std::size_t n, double s) : cdf(n) {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(i + 1.0, s);
+            cdf[i] = sum;
+        }
+        for (double &value : cdf) {
+            value /= sum;
+        }
+    }
+
+    template <typename Rng> std::size_t operator()(Rng &rng) const {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), u);
+        return std::min<std::size_t>(it - cdf.begin(), cdf.size() - 1);
+    }
+};
+
+// Products the workers know of, shared between them. The ones loaded at the
+// start are picked with Zipf popularity in a fixed shuffled order, added ones
+// uniformly in proportion to their number. Victims of removes are picked
+// uniformly, so they mostly come from the cold tail, and leave the set with
+// the last key taking their place.
+class KeySet {
+  public:
+    using Key = std::pair<int, ezlib::Interned>;
+
+  private:
+    mutable std::shared_timed_mutex lock;
+    std::vector<Key> keys;
+    std::size_t loaded;
+    Zipf hot;
+
+  public:
+    explicit KeySet(std::vector<Key> start)
+        : keys(std::move(start)), loaded(keys.size()), hot(loaded, 1.0) {}
+
+    // False if the set is empty.
+    template <typename Rng> bool pick(Rng &rng, Key &key) const {
+        std::shared_lock<std::shared_timed_mutex> guard(lock);
+        if (keys.empty()) {
+            return false;
+        }
+        std::uniform_int_distribution<std::size_t> any(0, keys.size() - 1);
+        std::size_t pos = any(rng);
+        if (pos < loaded) {
+            pos = hot(rng);
+            if (pos >= keys.size()) {
+                pos = any(rng);
+            }
+        }
+        key = keys[pos];
+        return true;
+    }
+
+    // Takes a uniformly chosen key out of the set. False if it is empty.
+    template <typename Rng> bool take(Rng &rng, Key &key) {
+        std::lock_guard<std::shared_timed_mutex> guard(lock);
+        if (keys.empty()) {
+            return false;
+        }
+        std::size_t pos =
+            std::uniform_int_distribution<std::size_t>(0, keys.size() - 1)(rng);
+        std::swap(keys[pos], keys.back());
+        key = std::move(keys.back());
+        keys.pop_back();
+        return true;
+    }
+
+    void add(Key key) {
+        std::lock_guard<std::shared_timed_mutex> guard(lock);
+        keys.push_back(std::move(key));
+    }
+};
+
+std::map<std::string, std::string> parseArgs(int argc, char **argv) {
+    std::map<std::string, std::string> ret;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            throw std::runtime_error("Unexpected argument " + arg);
+        }
+        arg = arg.substr(2);
+        if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--")) {
+            ret[arg] = argv[++i];
+        } else {
+            ret[arg] = "1";
+        }
+    }
+    return ret;
+}
+
+std::string arg(const std::map<std::string, std::string> &args,
+                const std::string &name, const std::string &fallback) {
+    auto found = args.find(name);
+    return found == args.end() ? fallback : found->second;
+}
+
+void removeTable(const std::string &path) {
+    for (const char *suffix : {"", ".name.idx", ".article.idx"}) {
+        std::remove((path + suffix).c_str());
+    }
+}
+
+const char *words[] = {"milk",   "bread", "cheese", "apple", "sugar",
+                       "rice",   "tea",   "coffee", "salt",  "butter",
+                       "yogurt", "honey", "flour",  "pasta", "juice",
+                       "beans",  "corn",  "oats",   "fish",  "pepper"};
+const char *kinds[] = {"fresh", "organic", "classic", "light", "premium",
+                       "local", "dark",    "sweet",   "smoked"};
+
+int generate(const std::map<std::string, std::string> &args) {
+    std::size_t products = std::stoul(arg(args, "products", "100000"));
+    std::size_t revenue =
+        std::stoul(arg(args, "revenue", std::to_string(products / 10)));
+    std::string dir = arg(args, "dir", ".");
+    std::mt19937_64 rng(std::stoull(arg(args, "seed", "1")));
+    removeTable(dir + "/products.txt");
+    removeTable(dir + "/revenue.txt");
+    std::remove((dir + "/sales.log").c_str());
+
+    const std::size_t wordCount = sizeof(words) / sizeof(*words);
+    const std::size_t kindCount = sizeof(kinds) / sizeof(*kinds);
+    Zipf wordPick(wordCount, 1.1);
+    Zipf kindPick(kindCount, 1.0);
+    Zipf manufacturerPick(40, 1.2);
+    Zipf categoryPick(12, 0.8);
+    std::exponential_distribution<double> expiryDays(1.0 / 30);
+    // Cents per kilogram.
+    std::uniform_int_distribution<std::int64_t> price(50, 5000);
+    std::time_t now = std::time(nullptr);
+
+    std::vector<Product> rows;
+    {
+        ElemTable<Product> table(dir + "/products.txt", TableFormat::Columns);
+        // Written on save, so the first run opens them without a rebuild.
+        table.addIndex<Product::NameComp>("name");
+        table.addIndex<Product::ArticleComp>("article");
+        for (std::size_t i = 0; i < products; ++i) {
+            Product prod;
+            prod.name = std::string(kinds[kindPick(rng)]) + " " +
+                        words[wordPick(rng)] + " " + std::to_string(i);
+            prod.manufacturer =
+                "manufacturer " + std::to_string(manufacturerPick(rng));
+            prod.category = "category " + std::to_string(categoryPick(rng));
+            prod.article = 100000 + i;
+            prod.weight = ezlib::Weight::fromMinor(100 * (1 + rng() % 50));
+            prod.availability = ezlib::Weight::fromMinor(1000 * (rng() % 500));
+            prod.buyPrice = ezlib::Money::fromMinor(price(rng));
+            prod.sellPrice =
+                ezlib::Money::fromMinor(prod.buyPrice.minor() * 13 / 10);
+            // A few percent are already past their date.
+            long long days = static_cast<long long>(expiryDays(rng)) - 2;
+            prod.expirationTime = now + days * 24 * 3600;
+            table.addRow(prod);
+            if (rows.size() < revenue) {
+                rows.push_back(prod);
+            }
+        }
+    }
+    {
+        ElemTable<Revenue> table(dir + "/revenue.txt", TableFormat::Columns);
+        table.addIndex<Revenue::NameComp>("name");
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            Revenue rev{};
+            rev.name = rows[i].name;
+            rev.article = rows[i].article;
+            rev.weightBuyed =
+                ezlib::Weight::fromMinor(1000000 / (i + 1) + rng() % 10000);
+            rev.revenue = ezlib::priceOf(rev.weightBuyed, rows[i].sellPrice);
+            table.addRow(rev);
+        }
+    }
+    std::cout << "Generated " << products << " products and " << rows.size()
+              << " revenue rows in " << dir << std::endl;
+    return 0;
+}
+
+enum Op { Lookup, Add, Edit, Remove, Sell, opCount };
+const char *opNames[opCount] = {"lookup", "add", "edit", "remove", "sell"};
+
+std::vector<int> parseMix(const std::string &mix) {
+    std::vector<int> weights(opCount, 0);
+    std::istringstream ss(mix);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        auto op = std::find(opNames, opNames + opCount, name) - opNames;
+        if (eq == std::string::npos || op == opCount) {
+            throw std::runtime_error("Bad mix entry " + item);
+        }
+        weights[op] = std::stoi(item.substr(eq + 1));
+    }
+    return weights;
+}
+
+double percentile(const std::vector<long long> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    std::size_t pos = static_cast<std::size_t>(p * (sorted.size() - 1));
+    return sorted[pos] / 1000.0;
+}
+
+Product newProduct(std::atomic<int> &nextArticle) {
+    Product prod;
+    prod.article = nextArticle++;
+    prod.name = "new product " + std::to_string(prod.article);
+    prod.availability = ezlib::Weight::fromMinor(10000);
+    return prod;
+}
+
+#ifdef __linux__
+// Runs `count` operations on one connection, `depth` requests at a time
+// before reading their responses. An edit needs the product first, so its
+// update goes out with the next batch. Latencies run from the sending of
+// the batch to the reading of the last response of the operation.
+template <typename Rng, typename Pick>
+void runPipelined(const std::string &socketPath, std::size_t depth,
+                  std::size_t count, Rng &rng, Pick &pickOp, KeySet &keys,
+                  std::atomic<int> &nextArticle,
+                  std::vector<std::vector<long long>> &latencies,
+                  std::size_t &misses) {
+    struct Sent {
+        Op op;
+        Clock::time_point start;
+        KeySet::Key key;
+        bool update;
+    };
+    ezlib::SocketClient client(socketPath);
+    std::vector<Sent> sent;
+    std::vector<std::pair<Clock::time_point, Product>> edits;
+    std::size_t started = 0;
+    while (started < count || !edits.empty()) {
+        sent.clear();
+        Clock::time_point start = Clock::now();
+        for (const auto &edit : edits) {
+            Product edited = edit.second;
+            edited.sellPrice += ezlib::Money::fromMinor(1);
+            client.send(ShopRequest(ShopOp::UpdateProduct)
+                            .put(edit.second.name.str())
+                            .putRecord(edited)
+                            .payload());
+            sent.push_back({Edit, edit.first, KeySet::Key(), true});
+        }
+        edits.clear();
+        for (; sent.size() < depth && started < count; ++started) {
+            Op op = static_cast<Op>(pickOp(rng));
+            KeySet::Key key;
+            if (op == Remove ? !keys.take(rng, key) : !keys.pick(rng, key)) {
+                op = Add;
+            }
+            std::string name = key.second.str();
+            auto article = static_cast<std::int32_t>(key.first);
+            if (op == Lookup && rng() % 2) {
+                client.send(
+                    ShopRequest(ShopOp::FindByName).put(name).payload());
+            } else if (op == Lookup || op == Edit) {
+                client.send(
+                    ShopRequest(ShopOp::FindByArticle).put(article).payload());
+            } else if (op == Add) {
+                Product prod = newProduct(nextArticle);
+                key = KeySet::Key(prod.article, prod.name);
+                client.send(
+                    ShopRequest(ShopOp::AddProduct).putRecord(prod).payload());
+            } else if (op == Remove) {
+                client.send(
+                    ShopRequest(ShopOp::RemoveProduct).put(name).payload());
+            } else {
+                client.send(ShopRequest(ShopOp::Sell)
+                                .put(name)
+                                .put(ezlib::Weight::fromMinor(1000))
+                                .put(ezlib::Money::fromMinor(100000000000))
+                                .payload());
+            }
+            sent.push_back({op, start, key, false});
+        }
+        client.flush();
+        for (Sent &request : sent) {
+            std::string response = client.receive();
+            ezlib::BufferReader in(response.data(), response.size());
+            ShopStatus status;
+            in.get(status);
+            bool done = status == ShopStatus::Ok;
+            if (request.op == Sell) {
+                std::uint8_t sale;
+                in.get(sale);
+                done = static_cast<SaleStatus>(sale) != SaleStatus::NoProduct;
+            } else if (request.op == Edit && !request.update && done) {
+                Product found;
+                getRecord(in, found);
+                edits.emplace_back(request.start, found);
+                continue;
+            } else if (request.op == Add) {
+                keys.add(std::move(request.key));
+            }
+            if (!done) {
+                misses++;
+            }
+            latencies[request.op].push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - request.start)
+                    .count());
+        }
+    }
+}
+#endif
+
+int run(const std::map<std::string, std::string> &args) {
+    unsigned threads = std::stoul(arg(args, "threads", "4"));
+    std::size_t ops = std::stoul(arg(args, "ops", "100000"));
+    std::string dir = arg(args, "dir", ".");
+    std::uint64_t seed = std::stoull(arg(args, "seed", "1"));
+    std::vector<int> weights =
+        parseMix(arg(args, "mix", "lookup=60,add=10,edit=15,remove=1,sell=14"));
+
+    Clock::time_point loadStart = Clock::now();
+    auto revenueLoad = std::async(std::launch::async, [&dir] {
+        return std::unique_ptr<ElemTable<Revenue>>(new ElemTable<Revenue>(
+            dir + "/revenue.txt", TableFormat::Columns));
+    });
+    ElemTable<Product> products(dir + "/products.txt", TableFormat::Columns);
+    std::unique_ptr<ElemTable<Revenue>> revenue = revenueLoad.get();
+    indexShopTables(products, *revenue);
+    SalesHistory history(dir + "/sales.log");
+    LocalShop local(products, *revenue, history);
+    double loadMs = std::chrono::duration<double, std::milli>(
+                        Clock::now() - loadStart)
+                        .count();
+    std::vector<KeySet::Key> loaded;
+    auto &list = products.getElements();
+    for (ezlib::ConstIterator<Product> it = list.begin(); it != list.end();
+         ++it) {
+        loaded.emplace_back(it->article, it->name);
+    }
+    if (loaded.empty()) {
+        std::cerr << "No products in " << dir << ", run generate first"
+                  << std::endl;
+        return 1;
+    }
+    std::shuffle(loaded.begin(), loaded.end(), std::mt19937_64(seed));
+    std::size_t loadedCount = loaded.size();
+    KeySet keys(std::move(loaded));
+    std::atomic<int> nextArticle(1 << 30);
+    std::string socketPath = arg(args, "connect", "");
+    std::size_t pipeline = std::stoul(arg(args, "pipeline", "1"));
+    if (pipeline > 1 && socketPath.empty()) {
+        throw std::runtime_error("--pipeline needs --connect");
+    }
+
+    // Lookups share the tables, everything else needs them exclusively. The
+    // server serializes requests itself.
+    std::shared_timed_mutex lock;
+    std::vector<std::vector<std::vector<long long>>> latencies(
+        threads, std::vector<std::vector<long long>>(opCount));
+    std::vector<std::size_t> misses(threads, 0);
+    std::vector<std::unique_ptr<Shop>> clients(threads);
+    if (!socketPath.empty() && pipeline <= 1) {
+#ifdef __linux__
+        for (auto &client : clients) {
+            client.reset(new RemoteShop(socketPath));
+        }
+#else
+        throw std::runtime_error("--connect is only available on Linux");
+#endif
+    }
+
+    auto worker = [&](unsigned id) {
+        Shop &shop = clients[id] ? *clients[id] : local;
+        std::shared_timed_mutex unshared;
+        std::shared_timed_mutex &guarded = clients[id] ? unshared : lock;
+        std::mt19937_64 rng(seed + id + 1);
+        std::discrete_distribution<int> pickOp(weights.begin(), weights.end());
+        std::size_t count = ops / threads + (id < ops % threads);
+#ifdef __linux__
+        if (pipeline > 1) {
+            runPipelined(socketPath, pipeline, count, rng, pickOp, keys,
+                         nextArticle, latencies[id], misses[id]);
+            return;
+        }
+#endif
+        for (std::size_t i = 0; i < count; ++i) {
+            Op op = static_cast<Op>(pickOp(rng));
+            KeySet::Key key;
+            if (op == Remove ? !keys.take(rng, key) : !keys.pick(rng, key)) {
+                op = Add;
+            }
+            Clock::time_point start = Clock::now();
+            bool done = true;
+            Product prod;
+            if (op == Lookup) {
+                std::shared_lock<std::shared_timed_mutex> guard(guarded);
+                if (rng() % 2) {
+                    done = shop.findProduct(key.first, prod);
+                } else {
+                    done = shop.findProduct(key.second, prod);
+                }
+            } else if (op == Add) {
+                prod = newProduct(nextArticle);
+                {
+                    std::lock_guard<std::shared_timed_mutex> guard(guarded);
+                    shop.addProduct(prod);
+                }
+                keys.add(KeySet::Key(prod.article, prod.name));
+            } else if (op == Edit) {
+                std::lock_guard<std::shared_timed_mutex> guard(guarded);
+                done = shop.findProduct(key.first, prod);
+                if (done) {
+                    Product edited = prod;
+                    edited.sellPrice += ezlib::Money::fromMinor(1);
+                    done = shop.updateProduct(prod.name, edited);
+                }
+            } else if (op == Remove) {
+                std::lock_guard<std::shared_timed_mutex> guard(guarded);
+                done = shop.removeProduct(key.second);
+            } else {
+                std::lock_guard<std::shared_timed_mutex> guard(guarded);
+                ezlib::Money price;
+                done = shop.sell(key.second, ezlib::Weight::fromMinor(1000),
+                                 ezlib::Money::fromMinor(100000000000),
+                                 price) != SaleStatus::NoProduct;
+            }
+            if (!done) {
+                misses[id]++;
+            }
+            latencies[id][op].push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start)
+                    .count());
+        }
+    };
+
+    Clock::time_point runStart = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned id = 0; id < threads; ++id) {
+        workers.emplace_back(worker, id);
+    }
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - runStart).count();
+
+    ezlib::Table tab('-', '|', '+');
+    tab.addRow({"Operation", "Count", "Ops/s", "p50 us", "p99 us", "p999 us"});
+    std::size_t total = 0;
+    for (int op = 0; op < opCount; ++op) {
+        std::vector<long long> all;
+        for (unsigned id = 0; id < threads; ++id) {
+            all.insert(all.end(), latencies[id][op].begin(),
+                       latencies[id][op].end());
+        }
+        std::sort(all.begin(), all.end());
+        total += all.size();
+        tab.addRow({opNames[op], std::to_string(all.size()),
+                    std::to_string(all.size() / seconds),
+                    std::to_string(percentile(all, 0.5)),
+                    std::to_string(percentile(all, 0.99)),
+                    std::to_string(percentile(all, 0.999))});
+    }
+    std::size_t missed = 0;
+    for (std::size_t value : misses) {
+        missed += value;
+    }
+    std::cout << "Loaded " << loadedCount << " products in " << loadMs
+              << " ms" << std::endl;
+    tab.print();
+    std::cout << total << " operations (" << missed << " misses) on "
+              << threads << " threads in " << seconds << " s, "
+              << total / seconds << " ops/s" << std::endl;
+
+    // A server saves on its own when it is stopped.
+    if (arg(args, "save", "").empty() || !socketPath.empty()) {
+        products.discardChanges();
+        revenue->discardChanges();
+        history.discardChanges();
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    try {
+        if (mode == "generate") {
+            return generate(parseArgs(argc, argv));
+        } else if (mode == "run") {
+            return run(parseArgs(argc, argv));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " generate|run [options]" << std::endl;
+    return 1;
+}
@@ -1,171 +1,38 @@
+#include "analytics.hpp"
+#include "elemTable.hpp"
 #include "linkedList.hpp"
+#include "records.hpp"
+#include "salesHistory.hpp"
+#include "shop.hpp"
+#include "stats.hpp"
 #include "table.hpp"
+#include "terminal.hpp"
 #include "utils.hpp"
+#ifdef __linux__
+#include "shopServer.hpp"
+#endif
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <ctime>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
-void clearScreen() {
-#ifdef _WIN32
-    system("cls");
-#elif defined __LINUX__
-    system("clear");
-#elif defined __APPLE__
-    system("clear");
-#endif
-}
+void clearScreen() { ezlib::Screen::global().clear(); }
+
+// Shared by every table the panel draws, shown in its header.
+ezlib::MemoryAccount panelMemory;
 
 inline void pressEnter() {
     std::cout << "Press Enter to continue...";
     getchar();
 }
 
-struct Product {
-  public:
-    std::string name;
-    std::string manufacturer;
-    int article;
-    float weight;
-    std::string category;
-    float availability;
-    float sellPrice;
-    float buyPrice;
-    std::time_t expirationTime;
-    struct NameComp {
-        constexpr NameComp() {}
-
-        constexpr bool operator()(const Product &c1,
-                                  const std::string &c) const {
-            return c1.name == c;
-        }
-        constexpr bool operator()(const std::string &c,
-                                  const Product &c1) const {
-            return c == c1.name;
-        }
-    };
-    struct ArticleComp {
-        constexpr bool operator()(const Product &c1, int c) const {
-            return c1.article == c;
-        }
-        constexpr bool operator()(int c, const Product &c1) const {
-            return c == c1.article;
-        }
-    };
-
-    Product()
-        : article(0), weight(0), availability(0), buyPrice(0), sellPrice(0),
-          expirationTime(0) {}
-};
-
-struct Revenue {
-  public:
-    std::string name;
-    unsigned int article;
-    float weightBuyed;
-    float revenue;
-    struct NameComp {
-        constexpr NameComp() {}
-
-        constexpr bool operator()(const Revenue &c1,
-                                  const std::string &c) const {
-            return c1.name == c;
-        }
-        constexpr bool operator()(const std::string &c,
-                                  const Revenue &c1) const {
-            return c == c1.name;
-        }
-    };
-    struct WeightSort {
-        constexpr bool operator()(const Revenue &lhs,
-                                  const Revenue &rhs) const {
-            return lhs.weightBuyed > rhs.weightBuyed;
-        }
-    };
-    struct RevenueSort {
-        constexpr bool operator()(const Revenue &lhs,
-                                  const Revenue &rhs) const {
-            return lhs.revenue > rhs.revenue;
-        }
-    };
-};
-
-template <typename T> class ElemTable {
-  private:
-    std::fstream fileHandle;
-    ezlib::LinkedList<T> elements;
-    std::string tableName;
-    int length;
-    bool isWrite;
-    bool isInitted;
-
-  public:
-    ElemTable(const std::string &tableFile) {
-        isWrite = false;
-        tableName = tableFile;
-        length = 0;
-        fileHandle.open(tableName,
-                        std::ios::in | std::ios::binary | std::ios::app);
-        if (fileHandle) {
-            fileHandle.seekg(0, std::ios::end);
-            length = (fileHandle.tellg() / sizeof(T));
-            T elem{};
-            for (int i = 0; i < length; ++i) {
-                fileHandle.seekg(i * sizeof(T), std::ios::beg);
-                fileHandle.read(reinterpret_cast<char *>(&elem), sizeof(T));
-                elements.push_back(elem);
-            }
-        }
-    }
-
-    ~ElemTable() {
-        fileHandle.close();
-        fileHandle.open(tableName,
-                        std::ios::out | std::ios::binary | std::ios::trunc);
-        int i = 0;
-        for (ezlib::Iterator<T> it = elements.begin(); it != elements.end();
-             ++it) {
-            fileHandle.seekg(i * sizeof(T), std::ios::beg);
-            fileHandle.write(reinterpret_cast<char *>(&(*it)), sizeof(T));
-            i++;
-        }
-    }
-
-    template <typename Compare, typename K> T &getRow(const K &key) {
-        return *elements.find_if_linear(key, Compare{});
-    }
-
-    ezlib::LinkedList<T> &getElements() { return elements; }
-    template <typename Compare, typename K>
-    void addOrUpdate(const T &row, const K &key) {
-        try {
-            T &prod = getRow<Compare>(key);
-            *prod = row;
-        } catch (const std::runtime_error &e) {
-            addRow(row);
-        }
-    }
-
-    void addRow(const T &row) {
-        if (!isWrite) {
-            isWrite = true;
-        }
-        length++;
-        elements.push_back(row);
-    }
-
-    template <typename Compare, typename K> void removeRow(const K &key) {
-        if (!isWrite) {
-            isWrite = true;
-        }
-        elements.template remove<Compare>(key, Compare{});
-        length--;
-    }
-
-    int getLength() { return length; }
-};
-
 void addHeader(ezlib::Table *tab) {
     tab->addRow({
         "Name",
@@ -202,9 +69,8 @@ std::string makeStringTime(const std::time_t &t) {
 
 void addProduct(ezlib::Table *tab, const Product &prod) {
     tab->addRow({prod.name, prod.manufacturer, std::to_string(prod.article),
-                 std::to_string(prod.weight), prod.category,
-                 std::to_string(prod.availability),
-                 std::to_string(prod.sellPrice), std::to_string(prod.buyPrice),
+                 prod.weight.str(), prod.category, prod.availability.str(),
+                 prod.sellPrice.str(), prod.buyPrice.str(),
                  makeStringTime(prod.expirationTime)});
 }
 
@@ -212,13 +78,12 @@ bool fillProduct(Product *prod, ezlib::Table &tab) {
     ezlib::Row &prodTable = tab.getRows()[1];
     int exp = 0;
     while (true) {
-        clearScreen();
-        tab.print();
-        std::cout << "1. Name\n2. Manufactorer\n3. Article\n4. "
-                     "Weight\n5. Category\n6. Availability\n7. Sell "
-                     "price\n8. Buy price\n9. Expiration time\n10. "
-                     "Save\n0. Exit\n"
-                  << std::endl;
+        // Only the edited cell changes between two rounds.
+        ezlib::Screen::global().draw(
+            tab.render() + "1. Name\n2. Manufactorer\n3. Article\n4. "
+                           "Weight\n5. Category\n6. Availability\n7. Sell "
+                           "price\n8. Buy price\n9. Expiration time\n10. "
+                           "Save\n0. Exit\n\n");
         int i = ezlib::input<int>("Choice: ");
         if (i == 1) {
             prod->name = ezlib::input<std::string>("Enter new name: ");
@@ -231,21 +96,23 @@ bool fillProduct(Product *prod, ezlib::Table &tab) {
             prod->article = ezlib::input<int>("Enter new article: ");
             prodTable[2] = std::to_string(prod->article);
         } else if (i == 4) {
-            prod->weight = ezlib::input<float>("Enter new weight: ");
-            prodTable[3] = std::to_string(prod->weight);
+            prod->weight = ezlib::input<ezlib::Weight>("Enter new weight: ");
+            prodTable[3] = prod->weight.str();
         } else if (i == 5) {
             prod->category = ezlib::input<std::string>("Enter new category: ");
             prodTable[4] = prod->category;
         } else if (i == 6) {
             prod->availability =
-                ezlib::input<float>("Enter new availability: ");
-            prodTable[5] = std::to_string(prod->availability);
+                ezlib::input<ezlib::Weight>("Enter new availability: ");
+            prodTable[5] = prod->availability.str();
         } else if (i == 7) {
-            prod->sellPrice = ezlib::input<float>("Enter new sell price: ");
-            prodTable[6] = std::to_string(prod->sellPrice);
+            prod->sellPrice =
+                ezlib::input<ezlib::Money>("Enter new sell price: ");
+            prodTable[6] = prod->sellPrice.str();
         } else if (i == 8) {
-            prod->buyPrice = ezlib::input<float>("Enter new buy price: ");
-            prodTable[7] = std::to_string(prod->buyPrice);
+            prod->buyPrice =
+                ezlib::input<ezlib::Money>("Enter new buy price: ");
+            prodTable[7] = prod->buyPrice.str();
         } else if (i == 9) {
             exp = ezlib::input<int>("Enter new expiration time(in days): ");
             exp = std::abs(exp);
@@ -264,60 +131,378 @@ bool fillProduct(Product *prod, ezlib::Table &tab) {
     }
 }
 
-template <typename T> void getProduct(Product **prod, ElemTable<T> &table) {
+// Lists the best matches for a partial name or manufacturer and lets the
+// user pick one of them.
+bool searchProduct(Product *prod, Shop &shop) {
+    std::string query = ezlib::input<std::string>("Enter part of name: ");
+    std::vector<Product> found = shop.searchProducts(query, 20);
+    if (found.empty()) {
+        std::cout << "Nothing matches " << query << std::endl;
+        pressEnter();
+        return false;
+    }
+    ezlib::Table tab('-', '|', '+', &panelMemory);
+    tab.addRow({"#", "Name", "Manufactorer", "Article", "Availability"});
+    for (std::size_t i = 0; i < found.size(); ++i) {
+        tab.addRow({std::to_string(i + 1), found[i].name,
+                    found[i].manufacturer, std::to_string(found[i].article),
+                    found[i].availability.str()});
+    }
+    while (true) {
+        clearScreen();
+        tab.print();
+        int choice = ezlib::input<int>("Number of product (0 to go back): ");
+        if (choice == 0) {
+            return false;
+        }
+        if (choice > 0 && choice <= static_cast<int>(found.size())) {
+            *prod = found[choice - 1];
+            return true;
+        }
+        std::cout << "Wrong selection!" << std::endl;
+        pressEnter();
+    }
+}
+
+// Copies the chosen product into `prod`, false if the user gave up.
+bool getProduct(Product *prod, Shop &shop) {
     while (true) {
         clearScreen();
         std::cout << "Type 0 for exit" << std::endl;
-        std::cout << "1. Search by name\t2. Search by article\t0. Exit\n";
+        std::cout << "1. Search by name\t2. Search by article\t"
+                     "3. Search by part of name\t0. Exit\n";
         int inp = ezlib::input<int>("Choice: ");
         if (inp == 0) {
-            break;
-        } else if (inp > 2 || inp < 0) {
+            return false;
+        } else if (inp > 3 || inp < 0) {
             std::cout << "Wrong selection!\n";
             pressEnter();
+            continue;
         }
-        try {
-            if (inp == 1) {
-                std::string name =
-                    ezlib::input<std::string>("Enter name of product: ");
-                *prod = &table.template getRow<Product::NameComp>(name);
-            } else if (inp == 2) {
-                int article = ezlib::input<int>("Enter article of product: ");
-                *prod = &table.template getRow<Product::ArticleComp>(article);
+        bool found;
+        if (inp == 1) {
+            std::string name =
+                ezlib::input<std::string>("Enter name of product: ");
+            found = shop.findProduct(name, *prod);
+        } else if (inp == 2) {
+            int article = ezlib::input<int>("Enter article of product: ");
+            found = shop.findProduct(article, *prod);
+        } else {
+            if (searchProduct(prod, shop)) {
+                return true;
             }
+            continue;
+        }
+        if (found) {
+            return true;
+        }
+        std::cout << "That product doesn't exists" << std::endl;
+        pressEnter();
+    }
+}
+
+void showAnalytics(Shop &shop) {
+    ezlib::Table sumTable('-', '|', '+', &panelMemory);
+    ProductGroup group = ProductGroup::Category;
+    while (true) {
+        sumTable.clear();
+        clearScreen();
+        GroupSummary summary = shop.summarize(group);
+        bool byCategory = group == ProductGroup::Category;
+        addSummary(&sumTable, byCategory ? "Category" : "Manufacturer",
+                   summary);
+        sumTable.print();
+        std::cout << "1. By category\t2. By manufacturer\t0. Exit\n";
+        int inp = ezlib::input<int>("Choice: ");
+        if (inp == 1) {
+            group = ProductGroup::Category;
+        } else if (inp == 2) {
+            group = ProductGroup::Manufacturer;
+        } else if (inp == 0) {
             break;
-        } catch (const std::runtime_error &e) {
-            std::cout << "That product doesn't exists" << std::endl;
+        } else {
+            std::cout << "Wrong selection!" << std::endl;
             pressEnter();
         }
     }
 }
 
-int main() {
-    ElemTable<Product> productsTable("products.txt");
-    ElemTable<Revenue> revenueTable("revenue.txt");
-    ezlib::Table tab('-', '|', '+');
+void showRangeSearch(Shop &shop) {
+    ezlib::Table tab('-', '|', '+', &panelMemory);
     while (true) {
         tab.clear();
         clearScreen();
-        std::cout << "!---- Shop control panel ----!" << std::endl;
-        std::cout << "!#    Products in table: " << productsTable.getLength()
-                  << "    #!" << std::endl;
-        std::cout << "1. Show all products in table" << std::endl;
-        std::cout << "2. Add new product" << std::endl;
-        std::cout << "3. Edit existing product" << std::endl;
-        std::cout << "4. Remove existing product" << std::endl;
-        std::cout << "5. Sell existing product" << std::endl;
-        std::cout << "6. Show revenue" << std::endl;
-        std::cout << "0. Exit" << std::endl;
+        std::cout << "1. Sell price between\t2. Availability below\t"
+                     "3. Expiring within days\t0. Exit\n";
+        int inp = ezlib::input<int>("Choice: ");
+        std::vector<Product> found;
+        if (inp == 1) {
+            ezlib::Money from = ezlib::input<ezlib::Money>("Price from: ");
+            ezlib::Money to = ezlib::input<ezlib::Money>("Price to: ");
+            found = shop.productsByPrice(from, to);
+        } else if (inp == 2) {
+            ezlib::Weight level =
+                ezlib::input<ezlib::Weight>("Reorder level: ");
+            found = shop.productsBelowStock(level);
+        } else if (inp == 3) {
+            int days = std::abs(ezlib::input<int>("Days: "));
+            std::time_t until = std::time(nullptr) + days * 3600 * 24;
+            // Zero means the product does not expire.
+            found = shop.productsExpiring(1, until);
+        } else if (inp == 0) {
+            break;
+        } else {
+            std::cout << "Wrong selection!" << std::endl;
+            pressEnter();
+            continue;
+        }
+        addHeader(&tab);
+        for (const Product &prod : found) {
+            addProduct(&tab, prod);
+        }
+        clearScreen();
+        tab.print();
+        std::cout << "Found: " << found.size() << std::endl;
+        pressEnter();
+    }
+}
+
+void printMemory(std::ostream &os, const std::string &name,
+                 const ezlib::MemoryAccount &mem) {
+    os << "!#    " << name << " memory: " << ezlib::formatBytes(mem.live)
+       << " (peak " << ezlib::formatBytes(mem.peak) << ", " << mem.allocations
+       << " allocations)    #!" << std::endl;
+}
+
+void showStats(Shop &shop) {
+    ezlib::Table statTable('-', '|', '+', &panelMemory);
+    while (true) {
+        statTable.clear();
+        clearScreen();
+        if (!ezlib::stats::enabled) {
+            std::cout << "Statistics are disabled in this build" << std::endl;
+            pressEnter();
+            return;
+        }
+        statTable.addRow({"Counter", "Value"});
+        ezlib::stats::Snapshot values = shop.stats();
+        for (int i = 0; i < ezlib::stats::counterCount; ++i) {
+            auto counter = static_cast<ezlib::stats::Counter>(i);
+            statTable.addRow({ezlib::stats::counterName(counter),
+                              std::to_string(values[i])});
+        }
+        statTable.print();
+        std::cout << "1. Reset\t0. Exit\n";
+        int inp = ezlib::input<int>("Choice: ");
+        if (inp == 1) {
+            shop.resetStats();
+        } else if (inp == 0) {
+            break;
+        } else {
+            std::cout << "Wrong selection!" << std::endl;
+            pressEnter();
+        }
+    }
+}
+
+std::string formatPeriod(std::time_t start, SalesPeriod period) {
+    char buf[32];
+    std::strftime(buf, sizeof(buf),
+                  period == SalesPeriod::Hour ? "%Y-%m-%d %H:00" : "%Y-%m-%d",
+                  std::localtime(&start));
+    return buf;
+}
+
+void showSalesHistory(Shop &shop) {
+    ezlib::Table salesTable('-', '|', '+', &panelMemory);
+    while (true) {
+        salesTable.clear();
+        clearScreen();
+        std::cout << "1. Today by hour\t2. Last 7 days\t3. Last 30 days\t"
+                     "4. Product in last 30 days\t0. Exit\n";
+        int inp = ezlib::input<int>("Choice: ");
+        std::time_t now = std::time(nullptr);
+        std::time_t today = localDayStart(now);
+        // Midday keeps the day right across clock changes.
+        auto daysAgo = [today](int days) {
+            return localDayStart(today - days * 24 * 3600 + 12 * 3600);
+        };
+        SalesPeriod period = SalesPeriod::Day;
+        std::time_t from;
+        if (inp == 1) {
+            period = SalesPeriod::Hour;
+            from = today;
+        } else if (inp == 2) {
+            from = daysAgo(6);
+        } else if (inp == 3) {
+            from = daysAgo(29);
+        } else if (inp == 4) {
+            std::string name =
+                ezlib::input<std::string>("Enter name of product: ");
+            SalesBucket sales;
+            if (shop.productSales(name, daysAgo(29), now + 1, sales)) {
+                std::cout << "Sales: " << sales.sales
+                          << "\tWeight: " << sales.weight
+                          << "\tRevenue: " << sales.revenue << std::endl;
+            } else {
+                std::cout << "That product doesn't exists" << std::endl;
+            }
+            pressEnter();
+            continue;
+        } else if (inp == 0) {
+            break;
+        } else {
+            std::cout << "Wrong selection!" << std::endl;
+            pressEnter();
+            continue;
+        }
+        SalesBucket total{from, 0, {}, {}};
+        salesTable.addRow({"Period", "Sales", "Weight", "Revenue"});
+        for (const SalesBucket &bucket :
+             shop.salesReport(period, from, now + 1)) {
+            salesTable.addRow({formatPeriod(bucket.start, period),
+                               std::to_string(bucket.sales),
+                               bucket.weight.str(), bucket.revenue.str()});
+            total.sales += bucket.sales;
+            total.weight += bucket.weight;
+            total.revenue += bucket.revenue;
+        }
+        salesTable.addRow({"Total", std::to_string(total.sales),
+                           total.weight.str(), total.revenue.str()});
+        clearScreen();
+        salesTable.print();
+        pressEnter();
+    }
+}
+
+void showRevenue(Shop &shop) {
+    ezlib::Table revTable('-', '|', '+', &panelMemory);
+    RevenueOrder order = RevenueOrder::Stored;
+    while (true) {
+        revTable.clear();
+        revTable.addRow({"Name", "Article", "Weight buyed", "Revenue"});
+        for (const Revenue &rev : shop.revenue(order)) {
+            revTable.addRow({rev.name, std::to_string(rev.article),
+                             rev.weightBuyed.str(), rev.revenue.str()});
+        }
+        // Rank of product prints five lines below the menu, plus the line
+        // the cursor is left on.
+        ezlib::Screen::global().draw(
+            revTable.render() +
+                "1. Sort by weight\t2. Sort by revenue\t"
+                "3. Rank of product\t4. Sales history\t0. Exit\n",
+            6);
+        int inp = ezlib::input<int>("Choice: ");
+        if (inp == 1) {
+            order = RevenueOrder::Weight;
+        } else if (inp == 2) {
+            order = RevenueOrder::Revenue;
+        } else if (inp == 3) {
+            std::string name =
+                ezlib::input<std::string>("Enter name of product: ");
+            RevenueRank rank;
+            if (shop.revenueRank(name, rank)) {
+                std::cout << "By weight: " << rank.byWeight << " of "
+                          << rank.total << std::endl;
+                std::cout << "By revenue: " << rank.byRevenue << " of "
+                          << rank.total << std::endl;
+            } else {
+                std::cout << "That product wasn't sold" << std::endl;
+            }
+            pressEnter();
+        } else if (inp == 4) {
+            showSalesHistory(shop);
+        } else if (inp == 0) {
+            break;
+        } else {
+            std::cout << "Wrong selection!" << std::endl;
+            pressEnter();
+        }
+    }
+}
+
+void sellProduct(Shop &shop, ezlib::Table &tab, const Product &prod) {
+    while (true) {
+        clearScreen();
+        tab.print();
+        std::cout << "0 to exit" << std::endl;
+        ezlib::Weight weight =
+            ezlib::input<ezlib::Weight>("Enter weight to sell(in kg): ");
+        if (weight == ezlib::Weight()) {
+            break;
+        }
+        if (weight < ezlib::Weight()) {
+            std::cout << "Weight must be positive number" << std::endl;
+            pressEnter();
+            continue;
+        }
+        if (weight > prod.availability) {
+            std::cout << "There is more than we have" << std::endl;
+            pressEnter();
+            continue;
+        }
+        ezlib::Money price = ezlib::priceOf(weight, prod.sellPrice);
+        while (true) {
+            std::cout << "0 to reenter weight" << std::endl;
+            std::cout << "Price: " << price << std::endl;
+            ezlib::Money payed =
+                ezlib::input<ezlib::Money>("How much client payed: ");
+            if (payed < ezlib::Money() || price > payed) {
+                std::cout << "Wrong input" << std::endl;
+                continue;
+            }
+            if (payed == ezlib::Money()) {
+                break;
+            }
+            // Another till may have changed the product since it was shown.
+            SaleStatus status = shop.sell(prod.name, weight, payed, price);
+            if (status == SaleStatus::Sold) {
+                std::cout << "Change to give: " << payed - price << std::endl;
+            } else if (status == SaleStatus::NoProduct) {
+                std::cout << "That product doesn't exists" << std::endl;
+            } else if (status == SaleStatus::NoStock) {
+                std::cout << "There is more than we have" << std::endl;
+            } else {
+                std::cout << "Price has changed to " << price << std::endl;
+            }
+            pressEnter();
+            return;
+        }
+    }
+}
+
+void runPanel(Shop &shop) {
+    ezlib::Table tab('-', '|', '+', &panelMemory);
+    while (true) {
+        tab.clear();
+        ShopMemory mem = shop.memory();
+        // Most rounds only change some of the numbers at the top.
+        std::ostringstream os;
+        os << "!---- Shop control panel ----!" << std::endl;
+        os << "!#    Products in table: " << shop.productCount() << "    #!"
+           << std::endl;
+        printMemory(os, "Products", mem.products);
+        printMemory(os, "Revenue", mem.revenue);
+        printMemory(os, "Strings", mem.strings);
+        printMemory(os, "Sales history", mem.history);
+        printMemory(os, "Panel tables", panelMemory);
+        os << "1. Show all products in table" << std::endl;
+        os << "2. Add new product" << std::endl;
+        os << "3. Edit existing product" << std::endl;
+        os << "4. Remove existing product" << std::endl;
+        os << "5. Sell existing product" << std::endl;
+        os << "6. Show revenue" << std::endl;
+        os << "7. Show statistics" << std::endl;
+        os << "8. Show stock and sales by group" << std::endl;
+        os << "9. Find products by price, stock or expiry" << std::endl;
+        os << "0. Exit" << std::endl;
+        ezlib::Screen::global().draw(os.str());
         int choice = ezlib::input<int>("Choice: ");
         if (choice == 1) {
             clearScreen();
-            auto &ll = productsTable.getElements();
             addHeader(&tab);
-            for (ezlib::Iterator<Product> it = ll.begin(); it != ll.end();
-                 ++it) {
-                addProduct(&tab, *it);
+            for (const Product &prod : shop.products()) {
+                addProduct(&tab, prod);
             }
             tab.print();
             pressEnter();
@@ -327,25 +512,25 @@ int main() {
             addHeader(&tab);
             addProduct(&tab, prod);
             if (fillProduct(&prod, tab)) {
-                productsTable.addRow(prod);
+                shop.addProduct(prod);
             }
         } else if (choice == 3) {
-            Product *prod = nullptr;
-            getProduct(&prod, productsTable);
-            if (prod != nullptr) {
-                Product newProd = *prod;
+            Product prod;
+            if (getProduct(&prod, shop)) {
+                Product newProd = prod;
                 addHeader(&tab);
-                addProduct(&tab, *prod);
-                if (fillProduct(&newProd, tab)) {
-                    *prod = newProd;
+                addProduct(&tab, prod);
+                if (fillProduct(&newProd, tab) &&
+                    !shop.updateProduct(prod.name, newProd)) {
+                    std::cout << "That product doesn't exists" << std::endl;
+                    pressEnter();
                 }
             }
         } else if (choice == 4) {
-            Product *prod = nullptr;
-            getProduct(&prod, productsTable);
-            if (prod != nullptr) {
+            Product prod;
+            if (getProduct(&prod, shop)) {
                 addHeader(&tab);
-                addProduct(&tab, *prod);
+                addProduct(&tab, prod);
                 while (true) {
                     clearScreen();
                     tab.print();
@@ -355,7 +540,7 @@ int main() {
                         inp.begin(), inp.end(), inp.begin(),
                         [](unsigned char c) { return std::tolower(c); });
                     if (inp == "y" || inp == "") {
-                        productsTable.removeRow<Product::NameComp>(prod->name);
+                        shop.removeProduct(prod.name);
                         break;
                     } else if (inp == "n") {
                         break;
@@ -366,98 +551,20 @@ int main() {
                 }
             }
         } else if (choice == 5) {
-            Product *prod = nullptr;
-            getProduct(&prod, productsTable);
-            if (prod != nullptr) {
+            Product prod;
+            if (getProduct(&prod, shop)) {
                 addHeader(&tab);
-                addProduct(&tab, *prod);
-                while (true) {
-                    clearScreen();
-                    tab.print();
-                    std::cout << "0 to exit" << std::endl;
-                    float weight =
-                        ezlib::input<float>("Enter weight to sell(in kg): ");
-                    if (weight == 0.0) {
-                        break;
-                    }
-                    if (weight < 0.0) {
-                        std::cout << "Weight must be positive number"
-                                  << std::endl;
-                        pressEnter();
-                        continue;
-                    }
-                    if (weight > prod->availability) {
-                        std::cout << "There is more than we have" << std::endl;
-                        pressEnter();
-                        continue;
-                    }
-                    float price = weight * prod->sellPrice;
-                    bool flag = false;
-                    while (true) {
-                        std::cout << "0 to reenter weight" << std::endl;
-                        std::cout << "Price: " << price << std::endl;
-                        float payed =
-                            ezlib::input<float>("How much client payed: ");
-                        if (payed < 0.0 || price > payed) {
-                            std::cout << "Wrong input" << std::endl;
-                            continue;
-                        }
-                        if (payed == 0.0) {
-                            break;
-                        }
-                        Revenue rev{};
-                        try {
-                            Revenue &revP =
-                                revenueTable.getRow<Revenue::NameComp>(
-                                    prod->name);
-                            revP.revenue += price;
-                            revP.weightBuyed += weight;
-                        } catch (const std::runtime_error &e) {
-                            rev.name = prod->name;
-                            rev.article = prod->article;
-                            rev.weightBuyed = weight;
-                            rev.revenue = price;
-                            revenueTable.addRow(rev);
-                        }
-                        prod->availability -= weight;
-                        std::cout << "Change to give: " << payed - price
-                                  << std::endl;
-                        pressEnter();
-                        flag = true;
-                        break;
-                    }
-                    if (flag) {
-                        break;
-                    }
-                }
+                addProduct(&tab, prod);
+                sellProduct(shop, tab, prod);
             }
         } else if (choice == 6) {
-            ezlib::Table revTable('-', '|', '+');
-            while (true) {
-                revTable.clear();
-                clearScreen();
-                revTable.addRow({"Name", "Article", "Weight buyed", "Revenue"});
-                auto &ll = revenueTable.getElements();
-                for (ezlib::Iterator<Revenue> it = ll.begin(); it != ll.end();
-                     ++it) {
-                    revTable.addRow({it->name, std::to_string(it->article),
-                                     std::to_string(it->weightBuyed),
-                                     std::to_string(it->revenue)});
-                }
-                revTable.print();
-                std::cout << "1. Sort by weight\t2. Sort by revenue\t0. Exit\n";
-                int inp = ezlib::input<int>("Choice: ");
-                if (inp == 1) {
-                    ll.sort(Revenue::WeightSort{});
-                } else if (inp == 2) {
-                    ll.sort(Revenue::RevenueSort{});
-                } else if (inp == 0) {
-                    break;
-                } else {
-                    std::cout << "Wrong selection!" << std::endl;
-                    pressEnter();
-                }
-            }
+            showRevenue(shop);
+        } else if (choice == 7) {
+            showStats(shop);
+        } else if (choice == 8) {
+            showAnalytics(shop);
+        } else if (choice == 9) {
+            showRangeSearch(shop);
         } else if (choice == 0) {
             break;
         } else {
@@ -465,5 +572,66 @@ int main() {
             pressEnter();
         }
     }
+}
+
+// cursach [--serve|--connect [socket]]
+//
+// Without arguments the panel works on the tables in the current directory,
+// or on the server if one is running there. --serve keeps the tables in this
+// process for panels started with --connect.
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    std::string socketPath = argc > 2 ? argv[2] : "cursach.sock";
+    if (mode != "" && mode != "--serve" && mode != "--connect") {
+        std::cerr << "Usage: " << argv[0] << " [--serve|--connect [socket]]"
+                  << std::endl;
+        return 1;
+    }
+    try {
+#ifdef __linux__
+        // Opening the tables next to a server would overwrite its changes.
+        if (mode == "--connect" ||
+            (mode == "" && ezlib::SocketServer::isListening(socketPath))) {
+            RemoteShop shop(socketPath);
+            runPanel(shop);
+            return 0;
+        }
+#else
+        if (mode != "") {
+            std::cerr << "Server mode is only available on Linux" << std::endl;
+            return 1;
+        }
+#endif
+        // Runs after the tables are saved, so save time is included.
+        std::atexit([] { ezlib::stats::dumpJson("stats.json"); });
+        // The tables do not depend on each other, load them side by side.
+        auto revenueLoad = std::async(std::launch::async, [] {
+            return std::unique_ptr<ElemTable<Revenue>>(
+                new ElemTable<Revenue>("revenue.txt", TableFormat::Columns));
+        });
+        ElemTable<Product> productsTable("products.txt", TableFormat::Columns);
+        std::unique_ptr<ElemTable<Revenue>> revenueTable = revenueLoad.get();
+        indexShopTables(productsTable, *revenueTable);
+        SalesHistory history("sales.log");
+        LocalShop shop(productsTable, *revenueTable, history);
+#ifdef __linux__
+        if (mode == "--serve") {
+            ShopService service(shop);
+            ezlib::SocketServer server(
+                socketPath, [&service](const char *data, std::size_t size,
+                                       std::string &response) {
+                    service.handle(data, size, response);
+                });
+            std::cout << "Serving " << shop.productCount() << " products on "
+                      << socketPath << std::endl;
+            server.run();
+            return 0;
+        }
+#endif
+        runPanel(shop);
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,88 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ezlib {
+
+// Read-only view of a whole file. Uses mmap where available and falls back
+// to reading the file into memory elsewhere.
+class MappedFile {
+  private:
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+#ifdef _WIN32
+    std::string buffer;
+#endif
+
+  public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path) {
+        close();
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        buffer = ss.str();
+        _data = buffer.data();
+        _size = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        _data = static_cast<const char *>(addr);
+        _size = st.st_size;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        buffer.clear();
+#else
+        if (_data != nullptr) {
+            munmap(const_cast<char *>(_data), _size);
+        }
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+    const char *data() const { return _data; }
+    std::size_t size() const { return _size; }
+    bool isOpen() const { return _data != nullptr; }
+};
+
+} // namespace ezlib
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <new>
+#include <sstream>
+#include <string>
+
+namespace ezlib {
+
+// Heap usage of one container. Not thread safe, guard it like the container
+// it belongs to.
+struct MemoryAccount {
+    std::size_t live = 0;
+    std::size_t peak = 0;
+    std::size_t allocations = 0;
+
+    void allocate(std::size_t bytes) {
+        live += bytes;
+        allocations++;
+        if (live > peak) {
+            peak = live;
+        }
+    }
+
+    void release(std::size_t bytes) { live -= bytes; }
+};
+
+// Standard allocator that reports every allocation to a MemoryAccount.
+template <typename T> class CountingAllocator {
+  public:
+    using value_type = T;
+
+    MemoryAccount *account;
+
+    explicit CountingAllocator(MemoryAccount *acc) noexcept : account(acc) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &other) noexcept
+        : account(other.account) {}
+
+    T *allocate(std::size_t n) {
+        T *ret = static_cast<T *>(::operator new(n * sizeof(T)));
+        account->allocate(n * sizeof(T));
+        return ret;
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        account->release(n * sizeof(T));
+        ::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U> &other) const {
+        return account == other.account;
+    }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U> &other) const {
+        return account != other.account;
+    }
+};
+
+inline std::string formatBytes(std::size_t bytes) {
+    static const char *units[] = {"B", "KiB", "MiB", "GiB"};
+    double value = bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 3) {
+        value /= 1024;
+        unit++;
+    }
+    std::ostringstream os;
+    os.precision(unit == 0 ? 0 : 1);
+    os << std::fixed << value << " " << units[unit];
+    return os.str();
+}
+
+} // namespace ezlib
+
+#endif
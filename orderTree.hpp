@@ -0,0 +1,157 @@
+#ifndef ORDERTREE_H
+#define ORDERTREE_H
+
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace ezlib {
+
+// Order statistic tree (a treap with subtree sizes). Insert, erase, rank and
+// access by position are O(log n) expected. Keys must be unique under comp.
+template <typename K, typename Compare> class OrderTree {
+  private:
+    struct Node {
+        K key;
+        unsigned priority;
+        std::size_t size = 1;
+        Node *left = nullptr;
+        Node *right = nullptr;
+
+        Node(const K &k, unsigned p) : key(k), priority(p) {}
+    };
+
+    Node *root = nullptr;
+    Compare comp;
+    std::minstd_rand rng;
+
+    static std::size_t sizeOf(const Node *node) {
+        return node != nullptr ? node->size : 0;
+    }
+
+    static void update(Node *node) {
+        node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+    }
+
+    // Splits `node` into keys ordered before `key` (or not after it, when
+    // `inclusive`) and the rest.
+    void split(Node *node, const K &key, bool inclusive, Node *&left,
+               Node *&right) {
+        if (node == nullptr) {
+            left = right = nullptr;
+            return;
+        }
+        bool goesLeft =
+            inclusive ? !comp(key, node->key) : comp(node->key, key);
+        if (goesLeft) {
+            split(node->right, key, inclusive, node->right, right);
+            left = node;
+        } else {
+            split(node->left, key, inclusive, left, node->left);
+            right = node;
+        }
+        update(node);
+    }
+
+    Node *merge(Node *left, Node *right) {
+        if (left == nullptr) {
+            return right;
+        }
+        if (right == nullptr) {
+            return left;
+        }
+        if (left->priority > right->priority) {
+            left->right = merge(left->right, right);
+            update(left);
+            return left;
+        }
+        right->left = merge(left, right->left);
+        update(right);
+        return right;
+    }
+
+    static void destroy(Node *node) {
+        if (node != nullptr) {
+            destroy(node->left);
+            destroy(node->right);
+            delete node;
+        }
+    }
+
+  public:
+    explicit OrderTree(Compare c = Compare()) : comp(c) {}
+    OrderTree(const OrderTree &) = delete;
+    OrderTree &operator=(const OrderTree &) = delete;
+    ~OrderTree() { destroy(root); }
+
+    std::size_t size() const { return sizeOf(root); }
+
+    void insert(const K &key) {
+        Node *left, *right;
+        split(root, key, false, left, right);
+        root = merge(merge(left, new Node(key, rng())), right);
+    }
+
+    bool erase(const K &key) {
+        Node *left, *mid, *right;
+        split(root, key, false, left, right);
+        split(right, key, true, mid, right);
+        bool found = mid != nullptr;
+        destroy(mid);
+        root = merge(left, right);
+        return found;
+    }
+
+    // Number of keys ordered before `key`.
+    std::size_t rank(const K &key) const {
+        std::size_t ret = 0;
+        for (const Node *node = root; node != nullptr;) {
+            if (comp(node->key, key)) {
+                ret += sizeOf(node->left) + 1;
+                node = node->right;
+            } else {
+                node = node->left;
+            }
+        }
+        return ret;
+    }
+
+    // Key at 0-based position `pos`.
+    const K &at(std::size_t pos) const {
+        if (pos >= size()) {
+            throw std::out_of_range("OrderTree position out of range");
+        }
+        const Node *node = root;
+        while (true) {
+            std::size_t leftSize = sizeOf(node->left);
+            if (pos < leftSize) {
+                node = node->left;
+            } else if (pos == leftSize) {
+                return node->key;
+            } else {
+                pos -= leftSize + 1;
+                node = node->right;
+            }
+        }
+    }
+
+    // Calls f on the keys in order.
+    template <typename F> void forEach(F f) const {
+        std::vector<const Node *> stack;
+        const Node *node = root;
+        while (node != nullptr || !stack.empty()) {
+            for (; node != nullptr; node = node->left) {
+                stack.push_back(node);
+            }
+            node = stack.back();
+            stack.pop_back();
+            f(node->key);
+            node = node->right;
+        }
+    }
+};
+
+} // namespace ezlib
+
+#endif
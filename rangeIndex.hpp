@@ -0,0 +1,202 @@
+#ifndef RANGEINDEX_H
+#define RANGEINDEX_H
+
+#include "memory.hpp"
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// In-memory structure over the rows of an ElemTable that is kept up to date
+// on every add, update and remove.
+template <typename T> class RowIndex {
+  public:
+    virtual ~RowIndex() {}
+    virtual void insert(T *row) = 0;
+    virtual void erase(T *row) = 0;
+    // True if moving from `from` to `to` changes the indexed value.
+    virtual bool differs(const T &from, const T &to) const = 0;
+    // Heap held by the index, if it counts it.
+    virtual ezlib::MemoryAccount getMemory() const {
+        return ezlib::MemoryAccount();
+    }
+};
+
+// Rows ordered by one numeric member, independent of the order of the list
+// they live in. The entries are a sorted array, changes since it was last
+// rebuilt are kept in two small sorted arrays (rows added and rows removed)
+// that lookups merge in. Lookups are O(log n + k + pending); an update
+// moves up to `pending` entries and every so often rebuilds the array.
+template <typename T, typename V> class RangeIndex : public RowIndex<T> {
+  private:
+    using Entry = std::pair<V, T *>;
+    using Entries = std::vector<Entry, ezlib::CountingAllocator<Entry>>;
+
+    struct Less {
+        bool operator()(const Entry &lhs, const Entry &rhs) const {
+            if (lhs.first < rhs.first || rhs.first < lhs.first) {
+                return lhs.first < rhs.first;
+            }
+            return std::less<T *>()(lhs.second, rhs.second);
+        }
+        bool operator()(const Entry &lhs, const V &rhs) const {
+            return lhs.first < rhs;
+        }
+        bool operator()(const V &lhs, const Entry &rhs) const {
+            return lhs < rhs.first;
+        }
+    };
+
+    V T::*field;
+    ezlib::MemoryAccount memory;
+    Entries sorted;
+    // Not in `sorted` yet, and in `sorted` but gone.
+    Entries added;
+    Entries removed;
+
+    static bool insertSorted(Entries &entries, const Entry &entry) {
+        auto it = std::lower_bound(entries.begin(), entries.end(), entry,
+                                   Less());
+        if (it != entries.end() && !Less()(entry, *it)) {
+            return false;
+        }
+        entries.insert(it, entry);
+        return true;
+    }
+
+    static bool eraseSorted(Entries &entries, const Entry &entry) {
+        auto it = std::lower_bound(entries.begin(), entries.end(), entry,
+                                   Less());
+        if (it == entries.end() || Less()(entry, *it)) {
+            return false;
+        }
+        entries.erase(it);
+        return true;
+    }
+
+    // Rebuilding costs a pass over the array, so changes are let grow
+    // with it.
+    void maybeRebuild() {
+        if (added.size() + removed.size() > sorted.size() / 256 + 1024) {
+            rebuild();
+        }
+    }
+
+    void rebuild() {
+        Entries merged{ezlib::CountingAllocator<Entry>(&memory)};
+        merged.reserve(sorted.size() + added.size() - removed.size());
+        auto gone = removed.begin();
+        auto fresh = added.begin();
+        Less less;
+        for (const Entry &entry : sorted) {
+            while (fresh != added.end() && less(*fresh, entry)) {
+                merged.push_back(*fresh++);
+            }
+            while (gone != removed.end() && less(*gone, entry)) {
+                ++gone;
+            }
+            if (gone != removed.end() && !less(entry, *gone)) {
+                continue;
+            }
+            merged.push_back(entry);
+        }
+        merged.insert(merged.end(), fresh, added.end());
+        sorted.swap(merged);
+        added.clear();
+        removed.clear();
+    }
+
+    // Rows of the entries in [lo, hi) of the array and of the added ones,
+    // in order, leaving out the removed ones.
+    template <typename It>
+    std::vector<const T *> collect(It first, It last, It addedFirst,
+                             It addedLast) const {
+        std::vector<const T *> ret;
+        Less less;
+        auto gone = removed.begin();
+        if (first != last) {
+            gone = std::lower_bound(removed.begin(), removed.end(), *first,
+                                    less);
+        }
+        for (; first != last; ++first) {
+            while (addedFirst != addedLast && less(*addedFirst, *first)) {
+                ret.push_back((addedFirst++)->second);
+            }
+            while (gone != removed.end() && less(*gone, *first)) {
+                ++gone;
+            }
+            if (gone == removed.end() || less(*first, *gone)) {
+                ret.push_back(first->second);
+            }
+        }
+        for (; addedFirst != addedLast; ++addedFirst) {
+            ret.push_back(addedFirst->second);
+        }
+        return ret;
+    }
+
+  public:
+    explicit RangeIndex(V T::*f)
+        : field(f), sorted(ezlib::CountingAllocator<Entry>(&memory)),
+          added(ezlib::CountingAllocator<Entry>(&memory)),
+          removed(ezlib::CountingAllocator<Entry>(&memory)) {}
+    // The arrays charge `memory` of the index they were made by.
+    RangeIndex(const RangeIndex &) = delete;
+    RangeIndex &operator=(const RangeIndex &) = delete;
+
+    V T::*getField() const { return field; }
+
+    void insert(T *row) override {
+        Entry entry(row->*field, row);
+        if (!eraseSorted(removed, entry)) {
+            insertSorted(added, entry);
+            maybeRebuild();
+        }
+    }
+
+    void erase(T *row) override {
+        Entry entry(row->*field, row);
+        if (!eraseSorted(added, entry)) {
+            insertSorted(removed, entry);
+            maybeRebuild();
+        }
+    }
+
+    // Same as inserting the rows one by one, but sorts them once.
+    template <typename Iterator> void insertAll(Iterator first, Iterator last) {
+        for (; first != last; ++first) {
+            added.emplace_back((*first).*field, &*first);
+        }
+        std::sort(added.begin(), added.end(), Less());
+        rebuild();
+    }
+
+    bool differs(const T &from, const T &to) const override {
+        return from.*field != to.*field;
+    }
+
+    ezlib::MemoryAccount getMemory() const override { return memory; }
+
+    // Rows with lo <= value <= hi, in ascending order of value.
+    std::vector<const T *> range(const V &lo, const V &hi) const {
+        if (hi < lo) {
+            return {};
+        }
+        return collect(
+            std::lower_bound(sorted.begin(), sorted.end(), lo, Less()),
+            std::upper_bound(sorted.begin(), sorted.end(), hi, Less()),
+            std::lower_bound(added.begin(), added.end(), lo, Less()),
+            std::upper_bound(added.begin(), added.end(), hi, Less()));
+    }
+
+    // Rows with value < hi, in ascending order of value.
+    std::vector<const T *> below(const V &hi) const {
+        return collect(
+            sorted.begin(),
+            std::lower_bound(sorted.begin(), sorted.end(), hi, Less()),
+            added.begin(),
+            std::lower_bound(added.begin(), added.end(), hi, Less()));
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include "fixed.hpp"
+#include "intern.hpp"
+#include <ctime>
+#include <string>
+
+// Strings repeated across many rows are interned, see ezlib::Interned.
+// Weights are in grams and money in minor units, see ezlib::Fixed; prices are
+// per kilogram.
+
+struct Product {
+  public:
+    ezlib::Interned name;
+    ezlib::Interned manufacturer;
+    int article;
+    ezlib::Weight weight;
+    ezlib::Interned category;
+    ezlib::Weight availability;
+    ezlib::Money sellPrice;
+    ezlib::Money buyPrice;
+    std::time_t expirationTime;
+    struct NameComp {
+        constexpr NameComp() {}
+
+        bool operator()(const Product &c1, const std::string &c) const {
+            return c1.name == c;
+        }
+        bool operator()(const std::string &c, const Product &c1) const {
+            return c == c1.name;
+        }
+        bool operator()(const Product &c1, const ezlib::Interned &c) const {
+            return c1.name == c;
+        }
+        bool operator()(const ezlib::Interned &c, const Product &c1) const {
+            return c == c1.name;
+        }
+        static const std::string &key(const Product &c) { return c.name; }
+    };
+    struct ArticleComp {
+        constexpr bool operator()(const Product &c1, int c) const {
+            return c1.article == c;
+        }
+        constexpr bool operator()(int c, const Product &c1) const {
+            return c == c1.article;
+        }
+        static int key(const Product &c) { return c.article; }
+    };
+
+    Product() : article(0), expirationTime(0) {}
+
+    // Calls visit on every stored member, in file order.
+    template <typename Self, typename V> static void fields(Self &c, V &visit) {
+        visit(c.name);
+        visit(c.manufacturer);
+        visit(c.article);
+        visit(c.weight);
+        visit(c.category);
+        visit(c.availability);
+        visit(c.sellPrice);
+        visit(c.buyPrice);
+        visit(c.expirationTime);
+    }
+};
+
+struct Revenue {
+  public:
+    ezlib::Interned name;
+    unsigned int article;
+    ezlib::Weight weightBuyed;
+    ezlib::Money revenue;
+    struct NameComp {
+        constexpr NameComp() {}
+
+        bool operator()(const Revenue &c1, const std::string &c) const {
+            return c1.name == c;
+        }
+        bool operator()(const std::string &c, const Revenue &c1) const {
+            return c == c1.name;
+        }
+        bool operator()(const Revenue &c1, const ezlib::Interned &c) const {
+            return c1.name == c;
+        }
+        bool operator()(const ezlib::Interned &c, const Revenue &c1) const {
+            return c == c1.name;
+        }
+        static const std::string &key(const Revenue &c) { return c.name; }
+    };
+    struct WeightSort {
+        constexpr bool operator()(const Revenue &lhs,
+                                  const Revenue &rhs) const {
+            return lhs.weightBuyed > rhs.weightBuyed;
+        }
+    };
+    struct RevenueSort {
+        constexpr bool operator()(const Revenue &lhs,
+                                  const Revenue &rhs) const {
+            return lhs.revenue > rhs.revenue;
+        }
+    };
+
+    template <typename Self, typename V> static void fields(Self &c, V &visit) {
+        visit(c.name);
+        visit(c.article);
+        visit(c.weightBuyed);
+        visit(c.revenue);
+    }
+};
+
+#endif
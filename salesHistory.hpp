@@ -0,0 +1,386 @@
+#ifndef SALESHISTORY_H
+#define SALESHISTORY_H
+
+#include "elemTable.hpp"
+#include "fixed.hpp"
+#include "mappedFile.hpp"
+#include "memory.hpp"
+#include "serialize.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct SaleEvent {
+    std::int64_t time;
+    std::int32_t article;
+    ezlib::Weight weight;
+    // The amount charged for the whole sale.
+    ezlib::Money price;
+};
+
+enum class SalesPeriod { Hour, Day };
+
+// Sales of one hour or day.
+struct SalesBucket {
+    std::time_t start;
+    std::uint64_t sales;
+    ezlib::Weight weight;
+    ezlib::Money revenue;
+
+    void add(const SaleEvent &event) {
+        sales++;
+        weight += event.weight;
+        revenue += event.price;
+    }
+};
+
+// Midnight local time of the day `time` falls on.
+inline std::time_t localDayStart(std::time_t time) {
+    std::tm local = *std::localtime(&time);
+    local.tm_hour = 0;
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    local.tm_isdst = -1;
+    return std::mktime(&local);
+}
+
+// Start of the local hour `time` falls in. Zones such as +05:30 do not start
+// their hours on multiples of 3600 seconds.
+inline std::time_t localHourStart(std::time_t time) {
+    std::tm local = *std::localtime(&time);
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    return std::mktime(&local);
+}
+
+// Every sale, in the order they were made, kept in memory in segments of a
+// fixed number of events, each knowing the earliest and latest sale in it.
+// Totals per hour and per local day are kept up to date on every sale, so
+// period reports cost one step per bucket whatever the number of sales.
+// Other totals are summed over the segments, which store their events column
+// by column for that.
+//
+// The log file is a Header followed by the events one after the other. It
+// is only ever appended to: new sales are written when the history is
+// destroyed, like the rows of an ElemTable. An event cut short by a crash
+// is dropped on the next load. Logs of version 1, with float weights and
+// prices, are rewritten in the current format when loaded.
+class SalesHistory {
+  public:
+    static constexpr std::size_t segmentEvents = 4096;
+
+  private:
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+    };
+
+    static constexpr std::uint32_t formatVersion = 2;
+
+    template <typename V>
+    using Column = std::vector<V, ezlib::CountingAllocator<V>>;
+    using Buckets = Column<SalesBucket>;
+
+    struct Segment {
+        std::int64_t minTime;
+        std::int64_t maxTime;
+        Column<std::int64_t> times;
+        Column<std::int32_t> articles;
+        // Grams and minor units.
+        Column<std::int64_t> weights;
+        Column<std::int64_t> prices;
+
+        Segment(ezlib::MemoryAccount *account, std::int64_t time)
+            : minTime(time), maxTime(time),
+              times(ezlib::CountingAllocator<std::int64_t>(account)),
+              articles(ezlib::CountingAllocator<std::int32_t>(account)),
+              weights(ezlib::CountingAllocator<std::int64_t>(account)),
+              prices(ezlib::CountingAllocator<std::int64_t>(account)) {
+            times.reserve(segmentEvents);
+            articles.reserve(segmentEvents);
+            weights.reserve(segmentEvents);
+            prices.reserve(segmentEvents);
+        }
+
+        std::size_t size() const { return times.size(); }
+
+        SaleEvent event(std::size_t i) const {
+            return SaleEvent{times[i], articles[i],
+                             ezlib::Weight::fromMinor(weights[i]),
+                             ezlib::Money::fromMinor(prices[i])};
+        }
+    };
+
+    std::string fileName;
+    bool fileExists = false;
+    // Events recorded since the load, encoded for the log.
+    std::string unsaved;
+    ezlib::MemoryAccount account;
+    std::vector<Segment, ezlib::CountingAllocator<Segment>> segments;
+    std::size_t length = 0;
+    Buckets hours;
+    Buckets days;
+    // The local day and hour of the last sale, most sales fall on them too.
+    std::time_t dayBegin = 0;
+    std::time_t dayEnd = 0;
+    std::time_t hourBegin = 0;
+    std::time_t hourEnd = 0;
+
+    std::time_t dayOf(std::time_t time) {
+        if (time < dayBegin || time >= dayEnd) {
+            dayBegin = localDayStart(time);
+            // Days around a clock change are not 24 hours long.
+            dayEnd = localDayStart(dayBegin + 36 * 3600);
+        }
+        return dayBegin;
+    }
+
+    std::time_t hourOf(std::time_t time) {
+        if (time < hourBegin || time >= hourEnd) {
+            hourBegin = localHourStart(time);
+            hourEnd = localHourStart(hourBegin + 5400);
+        }
+        return hourBegin;
+    }
+
+    static void addTo(Buckets &buckets, std::time_t start,
+                      const SaleEvent &event) {
+        auto it = buckets.end();
+        if (buckets.empty() || buckets.back().start < start) {
+            it = buckets.insert(it, SalesBucket{start, 0, {}, {}});
+        } else {
+            // A sale older than the last one, e.g. after the clock was set
+            // back.
+            it = std::lower_bound(buckets.begin(), buckets.end(), start,
+                                  [](const SalesBucket &bucket,
+                                     std::time_t key) {
+                                      return bucket.start < key;
+                                  });
+            if (it == buckets.end() || it->start != start) {
+                it = buckets.insert(it, SalesBucket{start, 0, {}, {}});
+            }
+        }
+        it->add(event);
+    }
+
+    void add(const SaleEvent &event) {
+        if (segments.empty() || segments.back().size() == segmentEvents) {
+            segments.emplace_back(&account, event.time);
+        }
+        Segment &segment = segments.back();
+        segment.minTime = std::min(segment.minTime, event.time);
+        segment.maxTime = std::max(segment.maxTime, event.time);
+        segment.times.push_back(event.time);
+        segment.articles.push_back(event.article);
+        segment.weights.push_back(event.weight.minor());
+        segment.prices.push_back(event.price.minor());
+        length++;
+        addTo(hours, hourOf(event.time), event);
+        addTo(days, dayOf(event.time), event);
+    }
+
+    static std::size_t eventSize(std::uint32_t version) {
+        std::size_t amounts =
+            version == 1 ? sizeof(float) : sizeof(std::int64_t);
+        return sizeof(std::int64_t) + sizeof(std::int32_t) + 2 * amounts;
+    }
+
+    static void putHeader(std::string &data) {
+        Header header{};
+        std::memcpy(header.magic, "EZSH", 4);
+        header.version = formatVersion;
+        data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    static void putEvent(std::string &data, const SaleEvent &event) {
+        ezlib::BufferWriter out(data);
+        out.put(event.time);
+        out.put(event.article);
+        out.put(event.weight);
+        out.put(event.price);
+    }
+
+    // Size of the valid part of the log, `version` is set to its format.
+    std::size_t load(const char *data, std::size_t size,
+                     std::uint32_t &version) {
+        ezlib::BufferReader in(data, size);
+        Header header;
+        in.get(header);
+        if (std::memcmp(header.magic, "EZSH", 4) != 0 || header.version < 1 ||
+            header.version > formatVersion) {
+            throw std::runtime_error("Unknown format of sales history " +
+                                     fileName);
+        }
+        version = header.version;
+        while (in.remaining() >= eventSize(version)) {
+            SaleEvent event;
+            in.get(event.time);
+            in.get(event.article);
+            if (version == 1) {
+                float weight, price;
+                in.get(weight);
+                in.get(price);
+                event.weight = ezlib::Weight::fromDouble(weight);
+                event.price = ezlib::Money::fromDouble(price);
+            } else {
+                in.get(event.weight);
+                in.get(event.price);
+            }
+            add(event);
+        }
+        return size - in.remaining();
+    }
+
+    // Adds up the events of one segment in [from, until) whose article is
+    // `article`, or all of them with `anyArticle`. A plain pass over the
+    // columns that compilers vectorize on targets with 64-bit vector compares
+    // (SSE4.2, AVX2, NEON).
+    static void sumSegment(const Segment &segment, std::int64_t from,
+                           std::int64_t until, std::int32_t article,
+                           bool anyArticle, SalesBucket &totals) {
+        const std::int64_t *times = segment.times.data();
+        const std::int32_t *articles = segment.articles.data();
+        const std::int64_t *weights = segment.weights.data();
+        const std::int64_t *prices = segment.prices.data();
+        std::size_t n = segment.size();
+        std::int64_t sales = 0, grams = 0, minor = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            bool hit = times[i] >= from && times[i] < until &&
+                       (anyArticle || articles[i] == article);
+            sales += hit;
+            grams += hit ? weights[i] : 0;
+            minor += hit ? prices[i] : 0;
+        }
+        totals.sales += sales;
+        totals.weight += ezlib::Weight::fromMinor(grams);
+        totals.revenue += ezlib::Money::fromMinor(minor);
+    }
+
+    SalesBucket sum(std::time_t from, std::time_t until, std::int32_t article,
+                    bool anyArticle) const {
+        SalesBucket totals{from, 0, {}, {}};
+        for (const Segment &segment : segments) {
+            if (segment.maxTime >= from && segment.minTime < until) {
+                sumSegment(segment, from, until, article, anyArticle, totals);
+            }
+        }
+        return totals;
+    }
+
+  public:
+    explicit SalesHistory(const std::string &file)
+        : fileName(file),
+          segments(ezlib::CountingAllocator<Segment>(&account)),
+          hours(ezlib::CountingAllocator<SalesBucket>(&account)),
+          days(ezlib::CountingAllocator<SalesBucket>(&account)) {
+        ezlib::MappedFile mapped;
+        if (!mapped.open(fileName)) {
+            return;
+        }
+        std::uint32_t version;
+        std::size_t valid = load(mapped.data(), mapped.size(), version);
+        if (version != formatVersion) {
+            std::string converted;
+            putHeader(converted);
+            forEach(std::numeric_limits<std::time_t>::min(),
+                    std::numeric_limits<std::time_t>::max(),
+                    [&converted](const SaleEvent &event) {
+                        putEvent(converted, event);
+                    });
+            mapped.close();
+            if (!replaceFile(fileName, converted)) {
+                throw std::runtime_error("Cannot convert " + fileName);
+            }
+        } else if (valid < mapped.size()) {
+            // New events would not line up after a partial one.
+            std::string kept(mapped.data(), valid);
+            mapped.close();
+            if (!replaceFile(fileName, kept)) {
+                throw std::runtime_error("Cannot repair " + fileName);
+            }
+        }
+        fileExists = true;
+    }
+    SalesHistory(const SalesHistory &) = delete;
+    SalesHistory &operator=(const SalesHistory &) = delete;
+    ~SalesHistory() { save(); }
+
+    void record(const SaleEvent &event) {
+        putEvent(unsaved, event);
+        add(event);
+    }
+
+    // Appends the events recorded since the last save to the log.
+    void save() {
+        if (unsaved.empty()) {
+            return;
+        }
+        std::ofstream out(fileName,
+                          std::ios::out | std::ios::binary | std::ios::app);
+        if (!fileExists) {
+            std::string header;
+            putHeader(header);
+            out.write(header.data(), header.size());
+        }
+        if (out.write(unsaved.data(), unsaved.size())) {
+            fileExists = true;
+            unsaved.clear();
+        }
+    }
+
+    // Keeps the log as it was loaded.
+    void discardChanges() { unsaved.clear(); }
+
+    // Totals of the hours or days starting in [from, until).
+    std::vector<SalesBucket> report(SalesPeriod period, std::time_t from,
+                                    std::time_t until) const {
+        const Buckets &buckets = period == SalesPeriod::Hour ? hours : days;
+        auto it = std::lower_bound(
+            buckets.begin(), buckets.end(), from,
+            [](const SalesBucket &bucket, std::time_t key) {
+                return bucket.start < key;
+            });
+        std::vector<SalesBucket> ret;
+        for (; it != buckets.end() && it->start < until; ++it) {
+            ret.push_back(*it);
+        }
+        return ret;
+    }
+
+    // Calls fn with every sale made in [from, until), reading only the
+    // segments whose time span overlaps it.
+    template <typename F>
+    void forEach(std::time_t from, std::time_t until, F fn) const {
+        for (const Segment &segment : segments) {
+            if (segment.maxTime < from || segment.minTime >= until) {
+                continue;
+            }
+            for (std::size_t i = 0; i < segment.size(); ++i) {
+                if (segment.times[i] >= from && segment.times[i] < until) {
+                    fn(segment.event(i));
+                }
+            }
+        }
+    }
+
+    // Totals of the sales made in [from, until), all or of one article.
+    SalesBucket totals(std::time_t from, std::time_t until) const {
+        return sum(from, until, 0, true);
+    }
+    SalesBucket totals(std::time_t from, std::time_t until,
+                       std::int32_t article) const {
+        return sum(from, until, article, false);
+    }
+
+    std::size_t size() const { return length; }
+
+    ezlib::MemoryAccount getMemory() const { return account; }
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include "intern.hpp"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace ezlib {
+
+// FNV-1a, 64 bit. Pass the previous result as seed to hash in pieces.
+inline std::uint64_t checksum(const char *data, std::size_t size,
+                              std::uint64_t seed = 14695981039346656037ULL) {
+    std::uint64_t hash = seed;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^
+           static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+}
+
+// Appends values to a byte buffer in native byte order.
+class BufferWriter {
+  private:
+    std::string &buffer;
+
+  public:
+    explicit BufferWriter(std::string &buf) : buffer(buf) {}
+
+    template <typename P> void put(const P &value) {
+        static_assert(std::is_trivially_copyable<P>::value,
+                      "put() needs a trivially copyable type");
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(P));
+    }
+
+    void put(const std::string &str) {
+        put(static_cast<std::uint32_t>(str.size()));
+        buffer.append(str);
+    }
+
+    void put(const Interned &str) { put(str.str()); }
+
+    // LEB128, 7 bits per byte.
+    void putVarint(std::uint64_t value) {
+        while (value >= 0x80) {
+            buffer += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        buffer += static_cast<char>(value);
+    }
+
+    void append(const std::string &bytes) { buffer.append(bytes); }
+
+    // Writes `value` at `pos`, used to patch sizes once they are known.
+    template <typename P> void patch(std::size_t pos, const P &value) {
+        std::memcpy(&buffer[pos], &value, sizeof(P));
+    }
+
+    std::size_t size() const { return buffer.size(); }
+};
+
+// Reads values written by BufferWriter, throws on truncated input.
+class BufferReader {
+  private:
+    const char *cur;
+    const char *end;
+
+    void need(std::size_t n) const {
+        if (static_cast<std::size_t>(end - cur) < n) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+    }
+
+  public:
+    BufferReader(const char *data, std::size_t size)
+        : cur(data), end(data + size) {}
+
+    template <typename P> void get(P &value) {
+        static_assert(std::is_trivially_copyable<P>::value,
+                      "get() needs a trivially copyable type");
+        need(sizeof(P));
+        std::memcpy(&value, cur, sizeof(P));
+        cur += sizeof(P);
+    }
+
+    void get(std::string &str) {
+        std::uint32_t len;
+        get(len);
+        need(len);
+        str.assign(cur, len);
+        cur += len;
+    }
+
+    void get(Interned &str) {
+        std::string value;
+        get(value);
+        str = value;
+    }
+
+    std::uint64_t getVarint() {
+        std::uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            unsigned char b = static_cast<unsigned char>(*cur++);
+            ret |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return ret;
+            }
+        }
+        throw std::runtime_error("Malformed varint");
+    }
+
+    const char *skip(std::size_t n) {
+        need(n);
+        const char *ret = cur;
+        cur += n;
+        return ret;
+    }
+
+    const char *position() const { return cur; }
+    std::size_t remaining() const { return end - cur; }
+};
+
+} // namespace ezlib
+
+#endif
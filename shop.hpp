@@ -0,0 +1,289 @@
+#ifndef SHOP_H
+#define SHOP_H
+
+#include "analytics.hpp"
+#include "elemTable.hpp"
+#include "intern.hpp"
+#include "memory.hpp"
+#include "records.hpp"
+#include "salesHistory.hpp"
+#include "stats.hpp"
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class RevenueOrder { Stored, Weight, Revenue };
+
+enum class SaleStatus { Sold, NoProduct, NoStock, Underpaid };
+
+struct RevenueRank {
+    std::size_t byWeight;
+    std::size_t byRevenue;
+    std::size_t total;
+};
+
+struct ShopMemory {
+    ezlib::MemoryAccount products;
+    ezlib::MemoryAccount revenue;
+    ezlib::MemoryAccount strings;
+    ezlib::MemoryAccount history;
+};
+
+using GroupSummary = std::unordered_map<ezlib::Interned, ProductSummary>;
+
+// What the shop panel does with the tables. Rows are returned by value, so
+// the panel works the same on tables of this process (LocalShop) and on a
+// server owning them (RemoteShop). Products are identified by name.
+class Shop {
+  public:
+    virtual ~Shop() {}
+
+    virtual int productCount() = 0;
+    virtual ShopMemory memory() = 0;
+    virtual std::vector<Product> products() = 0;
+    virtual bool findProduct(const std::string &name, Product &found) = 0;
+    virtual bool findProduct(int article, Product &found) = 0;
+    // Products whose name or manufacturer matches a partial text, best
+    // matches first.
+    virtual std::vector<Product> searchProducts(const std::string &query,
+                                                std::size_t limit) = 0;
+    virtual void addProduct(const Product &prod) = 0;
+    // False if there is no product called `name`.
+    virtual bool updateProduct(const std::string &name,
+                               const Product &prod) = 0;
+    virtual bool removeProduct(const std::string &name) = 0;
+    // Sells `weight` of a product if `payed` covers it. `price` is set to
+    // the amount charged.
+    virtual SaleStatus sell(const std::string &name, ezlib::Weight weight,
+                            ezlib::Money payed, ezlib::Money &price) = 0;
+    virtual std::vector<Revenue> revenue(RevenueOrder order) = 0;
+    virtual bool revenueRank(const std::string &name, RevenueRank &rank) = 0;
+    // Sales per hour or day, for the periods starting in [from, until).
+    virtual std::vector<SalesBucket>
+    salesReport(SalesPeriod period, std::time_t from, std::time_t until) = 0;
+    // Sales of one product in [from, until), false if there is no product
+    // called `name`.
+    virtual bool productSales(const std::string &name, std::time_t from,
+                              std::time_t until, SalesBucket &sales) = 0;
+    virtual GroupSummary summarize(ProductGroup group) = 0;
+    virtual std::vector<Product> productsByPrice(ezlib::Money from,
+                                                 ezlib::Money to) = 0;
+    virtual std::vector<Product> productsBelowStock(ezlib::Weight level) = 0;
+    // Products expiring in [from, until].
+    virtual std::vector<Product> productsExpiring(std::time_t from,
+                                                  std::time_t until) = 0;
+    virtual ezlib::stats::Snapshot stats() = 0;
+    virtual void resetStats() = 0;
+};
+
+// Indexes the shop panel relies on.
+inline void indexShopTables(ElemTable<Product> &products,
+                            ElemTable<Revenue> &revenue) {
+    products.addIndex<Product::NameComp>("name");
+    products.addIndex<Product::ArticleComp>("article");
+    products.addRangeIndex(&Product::sellPrice);
+    products.addRangeIndex(&Product::availability);
+    products.addRangeIndex(&Product::expirationTime);
+    products.addTextIndex({&Product::name, &Product::manufacturer});
+    // Sales and rank queries find the revenue row by name first.
+    revenue.addIndex<Revenue::NameComp>("name");
+    revenue.addLeaderboard<Revenue::WeightSort>();
+    revenue.addLeaderboard<Revenue::RevenueSort>();
+}
+
+// Shop over tables opened by this process, see indexShopTables.
+class LocalShop : public Shop {
+  private:
+    ElemTable<Product> &productsTable;
+    ElemTable<Revenue> &revenueTable;
+    SalesHistory &salesHistory;
+
+    template <typename Compare, typename K>
+    bool find(const K &key, Product &found) {
+        try {
+            found = productsTable.template getRow<Compare>(key);
+            return true;
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+    }
+
+    static std::vector<Product>
+    copy(const std::vector<const Product *> &rows) {
+        std::vector<Product> ret;
+        ret.reserve(rows.size());
+        for (const Product *row : rows) {
+            ret.push_back(*row);
+        }
+        return ret;
+    }
+
+  public:
+    LocalShop(ElemTable<Product> &products, ElemTable<Revenue> &revenue,
+              SalesHistory &history)
+        : productsTable(products), revenueTable(revenue),
+          salesHistory(history) {}
+
+    int productCount() override { return productsTable.getLength(); }
+
+    ShopMemory memory() override {
+        return ShopMemory{productsTable.getMemory(), revenueTable.getMemory(),
+                          ezlib::StringPool::global().getMemory(),
+                          salesHistory.getMemory()};
+    }
+
+    std::vector<Product> products() override {
+        std::vector<Product> ret;
+        auto &ll = productsTable.getElements();
+        ret.reserve(ll.size);
+        for (ezlib::ConstIterator<Product> it = ll.begin(); it != ll.end();
+             ++it) {
+            ret.push_back(*it);
+        }
+        return ret;
+    }
+
+    bool findProduct(const std::string &name, Product &found) override {
+        return find<Product::NameComp>(name, found);
+    }
+
+    bool findProduct(int article, Product &found) override {
+        return find<Product::ArticleComp>(article, found);
+    }
+
+    std::vector<Product> searchProducts(const std::string &query,
+                                        std::size_t limit) override {
+        return copy(productsTable.search(query, limit));
+    }
+
+    void addProduct(const Product &prod) override {
+        productsTable.addRow(prod);
+    }
+
+    bool updateProduct(const std::string &name, const Product &prod) override {
+        try {
+            const Product &row =
+                productsTable.getRow<Product::NameComp>(name);
+            productsTable.updateRow(row, prod);
+            return true;
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+    }
+
+    bool removeProduct(const std::string &name) override {
+        return productsTable.removeRow<Product::NameComp>(name) > 0;
+    }
+
+    SaleStatus sell(const std::string &name, ezlib::Weight weight,
+                    ezlib::Money payed, ezlib::Money &price) override {
+        const Product *prod;
+        try {
+            prod = &productsTable.getRow<Product::NameComp>(name);
+        } catch (const std::runtime_error &e) {
+            return SaleStatus::NoProduct;
+        }
+        if (weight > prod->availability) {
+            return SaleStatus::NoStock;
+        }
+        price = ezlib::priceOf(weight, prod->sellPrice);
+        if (price > payed) {
+            return SaleStatus::Underpaid;
+        }
+        try {
+            const Revenue &revP =
+                revenueTable.getRow<Revenue::NameComp>(prod->name);
+            Revenue updated = revP;
+            updated.revenue += price;
+            updated.weightBuyed += weight;
+            revenueTable.updateRow(revP, updated);
+        } catch (const std::runtime_error &e) {
+            Revenue rev{};
+            rev.name = prod->name;
+            rev.article = prod->article;
+            rev.weightBuyed = weight;
+            rev.revenue = price;
+            revenueTable.addRow(rev);
+        }
+        salesHistory.record(
+            SaleEvent{std::time(nullptr), prod->article, weight, price});
+        Product sold = *prod;
+        sold.availability -= weight;
+        productsTable.updateRow(*prod, sold);
+        return SaleStatus::Sold;
+    }
+
+    std::vector<Revenue> revenue(RevenueOrder order) override {
+        std::vector<Revenue> ret;
+        auto add = [&ret](const Revenue *rev) { ret.push_back(*rev); };
+        if (order == RevenueOrder::Weight) {
+            revenueTable.getLeaderboard<Revenue::WeightSort>().forEach(add);
+        } else if (order == RevenueOrder::Revenue) {
+            revenueTable.getLeaderboard<Revenue::RevenueSort>().forEach(add);
+        } else {
+            auto &ll = revenueTable.getElements();
+            for (ezlib::ConstIterator<Revenue> it = ll.begin(); it != ll.end();
+                 ++it) {
+                add(&*it);
+            }
+        }
+        return ret;
+    }
+
+    bool revenueRank(const std::string &name, RevenueRank &rank) override {
+        try {
+            const Revenue &rev =
+                revenueTable.getRow<Revenue::NameComp>(name);
+            auto &byWeight = revenueTable.getLeaderboard<Revenue::WeightSort>();
+            auto &byRevenue =
+                revenueTable.getLeaderboard<Revenue::RevenueSort>();
+            rank = RevenueRank{byWeight.rank(&rev), byRevenue.rank(&rev),
+                               byWeight.size()};
+            return true;
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+    }
+
+    std::vector<SalesBucket> salesReport(SalesPeriod period, std::time_t from,
+                                         std::time_t until) override {
+        return salesHistory.report(period, from, until);
+    }
+
+    bool productSales(const std::string &name, std::time_t from,
+                      std::time_t until, SalesBucket &sales) override {
+        Product prod;
+        if (!find<Product::NameComp>(name, prod)) {
+            return false;
+        }
+        sales = salesHistory.totals(from, until, prod.article);
+        return true;
+    }
+
+    GroupSummary summarize(ProductGroup group) override {
+        return summarizeProducts(productsTable.getElements(),
+                                 revenueTable.getElements(), group);
+    }
+
+    std::vector<Product> productsByPrice(ezlib::Money from,
+                                         ezlib::Money to) override {
+        return copy(productsTable.findRange(&Product::sellPrice, from, to));
+    }
+
+    std::vector<Product> productsBelowStock(ezlib::Weight level) override {
+        return copy(productsTable.findBelow(&Product::availability, level));
+    }
+
+    std::vector<Product> productsExpiring(std::time_t from,
+                                          std::time_t until) override {
+        return copy(
+            productsTable.findRange(&Product::expirationTime, from, until));
+    }
+
+    ezlib::stats::Snapshot stats() override { return ezlib::stats::snapshot(); }
+
+    void resetStats() override { ezlib::stats::reset(); }
+};
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef SHOPSERVER_H
+#define SHOPSERVER_H
+
+#include "serialize.hpp"
+#include "shop.hpp"
+#include "unixSocket.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Shop requests over a SocketServer. A request is the operation code
+// followed by its arguments; a response starts with a ShopStatus followed by
+// the results. Rows are encoded through their fields() lists, lists of rows
+// are prefixed with a varint count. Both ends are the same build on one
+// machine, so plain structs such as ShopMemory go as they are in memory.
+enum class ShopOp : std::uint8_t {
+    ProductCount,
+    Memory,
+    Products,
+    FindByName,
+    FindByArticle,
+    AddProduct,
+    UpdateProduct,
+    RemoveProduct,
+    Sell,
+    Revenue,
+    RevenueRank,
+    Summarize,
+    ProductsByPrice,
+    ProductsBelowStock,
+    ProductsExpiring,
+    Stats,
+    ResetStats,
+    SearchProducts,
+    SalesReport,
+    ProductSales,
+};
+
+enum class ShopStatus : std::uint8_t { Ok, NotFound };
+
+template <typename R>
+void putRecord(ezlib::BufferWriter &out, const R &row) {
+    auto put = [&out](const auto &value) { out.put(value); };
+    R::fields(row, put);
+}
+
+template <typename R> void getRecord(ezlib::BufferReader &in, R &row) {
+    auto get = [&in](auto &value) { in.get(value); };
+    R::fields(row, get);
+}
+
+template <typename R>
+void putRecords(ezlib::BufferWriter &out, const std::vector<R> &rows) {
+    out.putVarint(rows.size());
+    for (const R &row : rows) {
+        putRecord(out, row);
+    }
+}
+
+template <typename R> std::vector<R> getRecords(ezlib::BufferReader &in) {
+    std::uint64_t count = in.getVarint();
+    std::vector<R> ret;
+    // Every row takes at least a byte, do not trust the count beyond that.
+    ret.reserve(std::min<std::uint64_t>(count, in.remaining()));
+    for (std::uint64_t i = 0; i < count; ++i) {
+        R row{};
+        getRecord(in, row);
+        ret.push_back(row);
+    }
+    return ret;
+}
+
+// Builds a request payload, e.g. ShopRequest(ShopOp::FindByName).put(name).
+class ShopRequest {
+  private:
+    std::string data;
+    ezlib::BufferWriter out;
+
+  public:
+    explicit ShopRequest(ShopOp op) : out(data) { out.put(op); }
+    ShopRequest(const ShopRequest &) = delete;
+    ShopRequest &operator=(const ShopRequest &) = delete;
+
+    template <typename P> ShopRequest &put(const P &value) {
+        out.put(value);
+        return *this;
+    }
+
+    template <typename R> ShopRequest &putRecord(const R &row) {
+        ::putRecord(out, row);
+        return *this;
+    }
+
+    const std::string &payload() const { return data; }
+};
+
+// Answers requests against the tables of this process, one at a time, on
+// the thread of the event loop. Malformed requests throw, which closes the
+// connection.
+class ShopService {
+  private:
+    Shop &shop;
+
+    template <typename E> static E getEnum(ezlib::BufferReader &in, E last) {
+        std::uint8_t value;
+        in.get(value);
+        if (value > static_cast<std::uint8_t>(last)) {
+            throw std::runtime_error("Bad request");
+        }
+        return static_cast<E>(value);
+    }
+
+  public:
+    explicit ShopService(Shop &s) : shop(s) {}
+
+    void handle(const char *data, std::size_t size, std::string &response) {
+        ezlib::BufferReader in(data, size);
+        ezlib::BufferWriter out(response);
+        ShopOp op = getEnum(in, ShopOp::ProductSales);
+        std::size_t statusPos = out.size();
+        out.put(ShopStatus::Ok);
+        auto found = [&out, statusPos](bool ok) {
+            if (!ok) {
+                out.patch(statusPos, ShopStatus::NotFound);
+            }
+        };
+        std::string name;
+        Product prod;
+        switch (op) {
+        case ShopOp::ProductCount:
+            out.put(static_cast<std::int32_t>(shop.productCount()));
+            break;
+        case ShopOp::Memory: {
+            ShopMemory mem = shop.memory();
+            out.put(mem);
+            break;
+        }
+        case ShopOp::Products:
+            putRecords(out, shop.products());
+            break;
+        case ShopOp::FindByName:
+            in.get(name);
+            found(shop.findProduct(name, prod));
+            putRecord(out, prod);
+            break;
+        case ShopOp::FindByArticle: {
+            std::int32_t article;
+            in.get(article);
+            found(shop.findProduct(article, prod));
+            putRecord(out, prod);
+            break;
+        }
+        case ShopOp::SearchProducts: {
+            std::uint32_t limit;
+            in.get(name);
+            in.get(limit);
+            putRecords(out, shop.searchProducts(name, limit));
+            break;
+        }
+        case ShopOp::AddProduct:
+            getRecord(in, prod);
+            shop.addProduct(prod);
+            break;
+        case ShopOp::UpdateProduct:
+            in.get(name);
+            getRecord(in, prod);
+            found(shop.updateProduct(name, prod));
+            break;
+        case ShopOp::RemoveProduct:
+            in.get(name);
+            found(shop.removeProduct(name));
+            break;
+        case ShopOp::Sell: {
+            ezlib::Weight weight;
+            ezlib::Money payed, price;
+            in.get(name);
+            in.get(weight);
+            in.get(payed);
+            SaleStatus status = shop.sell(name, weight, payed, price);
+            out.put(static_cast<std::uint8_t>(status));
+            out.put(price);
+            break;
+        }
+        case ShopOp::Revenue:
+            putRecords(out, shop.revenue(getEnum(in, RevenueOrder::Revenue)));
+            break;
+        case ShopOp::RevenueRank: {
+            RevenueRank rank{0, 0, 0};
+            in.get(name);
+            found(shop.revenueRank(name, rank));
+            out.put(rank);
+            break;
+        }
+        case ShopOp::SalesReport: {
+            SalesPeriod period = getEnum(in, SalesPeriod::Day);
+            std::time_t from, until;
+            in.get(from);
+            in.get(until);
+            std::vector<SalesBucket> buckets =
+                shop.salesReport(period, from, until);
+            out.putVarint(buckets.size());
+            for (const SalesBucket &bucket : buckets) {
+                out.put(bucket);
+            }
+            break;
+        }
+        case ShopOp::ProductSales: {
+            std::time_t from, until;
+            SalesBucket sales{0, 0, {}, {}};
+            in.get(name);
+            in.get(from);
+            in.get(until);
+            found(shop.productSales(name, from, until, sales));
+            out.put(sales);
+            break;
+        }
+        case ShopOp::Summarize: {
+            GroupSummary summary =
+                shop.summarize(getEnum(in, ProductGroup::Manufacturer));
+            out.putVarint(summary.size());
+            for (const auto &group : summary) {
+                out.put(group.first);
+                out.put(group.second);
+            }
+            break;
+        }
+        case ShopOp::ProductsByPrice: {
+            ezlib::Money from, to;
+            in.get(from);
+            in.get(to);
+            putRecords(out, shop.productsByPrice(from, to));
+            break;
+        }
+        case ShopOp::ProductsBelowStock: {
+            ezlib::Weight level;
+            in.get(level);
+            putRecords(out, shop.productsBelowStock(level));
+            break;
+        }
+        case ShopOp::ProductsExpiring: {
+            std::time_t from, until;
+            in.get(from);
+            in.get(until);
+            putRecords(out, shop.productsExpiring(from, until));
+            break;
+        }
+        case ShopOp::Stats: {
+            ezlib::stats::Snapshot values = shop.stats();
+            out.putVarint(values.size());
+            for (std::uint64_t value : values) {
+                out.putVarint(value);
+            }
+            break;
+        }
+        case ShopOp::ResetStats:
+            shop.resetStats();
+            break;
+        }
+    }
+};
+
+// Shop served by a `cursach --serve` process.
+class RemoteShop : public Shop {
+  private:
+    ezlib::SocketClient client;
+    std::string response;
+
+    // Sends the request and returns a reader positioned after the status.
+    ezlib::BufferReader call(const ShopRequest &request, bool *ok = nullptr) {
+        response = client.call(request.payload());
+        ezlib::BufferReader in(response.data(), response.size());
+        ShopStatus status;
+        in.get(status);
+        if (ok != nullptr) {
+            *ok = status == ShopStatus::Ok;
+        }
+        return in;
+    }
+
+    std::vector<Product> products(const ShopRequest &request) {
+        ezlib::BufferReader in = call(request);
+        return getRecords<Product>(in);
+    }
+
+    bool find(const ShopRequest &request, Product &found) {
+        bool ok;
+        ezlib::BufferReader in = call(request, &ok);
+        if (ok) {
+            getRecord(in, found);
+        }
+        return ok;
+    }
+
+  public:
+    explicit RemoteShop(const std::string &socketPath) : client(socketPath) {}
+
+    int productCount() override {
+        std::int32_t count;
+        call(ShopRequest(ShopOp::ProductCount)).get(count);
+        return count;
+    }
+
+    ShopMemory memory() override {
+        ShopMemory mem;
+        call(ShopRequest(ShopOp::Memory)).get(mem);
+        return mem;
+    }
+
+    std::vector<Product> products() override {
+        return products(ShopRequest(ShopOp::Products));
+    }
+
+    bool findProduct(const std::string &name, Product &found) override {
+        return find(ShopRequest(ShopOp::FindByName).put(name), found);
+    }
+
+    bool findProduct(int article, Product &found) override {
+        return find(ShopRequest(ShopOp::FindByArticle)
+                        .put(static_cast<std::int32_t>(article)),
+                    found);
+    }
+
+    std::vector<Product> searchProducts(const std::string &query,
+                                        std::size_t limit) override {
+        return products(ShopRequest(ShopOp::SearchProducts)
+                            .put(query)
+                            .put(static_cast<std::uint32_t>(limit)));
+    }
+
+    void addProduct(const Product &prod) override {
+        call(ShopRequest(ShopOp::AddProduct).putRecord(prod));
+    }
+
+    bool updateProduct(const std::string &name, const Product &prod) override {
+        bool ok;
+        call(ShopRequest(ShopOp::UpdateProduct).put(name).putRecord(prod), &ok);
+        return ok;
+    }
+
+    bool removeProduct(const std::string &name) override {
+        bool ok;
+        call(ShopRequest(ShopOp::RemoveProduct).put(name), &ok);
+        return ok;
+    }
+
+    SaleStatus sell(const std::string &name, ezlib::Weight weight,
+                    ezlib::Money payed, ezlib::Money &price) override {
+        ezlib::BufferReader in = call(
+            ShopRequest(ShopOp::Sell).put(name).put(weight).put(payed));
+        std::uint8_t status;
+        in.get(status);
+        in.get(price);
+        return static_cast<SaleStatus>(status);
+    }
+
+    std::vector<Revenue> revenue(RevenueOrder order) override {
+        auto value = static_cast<std::uint8_t>(order);
+        ezlib::BufferReader in = call(ShopRequest(ShopOp::Revenue).put(value));
+        return getRecords<Revenue>(in);
+    }
+
+    bool revenueRank(const std::string &name, RevenueRank &rank) override {
+        bool ok;
+        call(ShopRequest(ShopOp::RevenueRank).put(name), &ok).get(rank);
+        return ok;
+    }
+
+    std::vector<SalesBucket> salesReport(SalesPeriod period, std::time_t from,
+                                         std::time_t until) override {
+        auto value = static_cast<std::uint8_t>(period);
+        ezlib::BufferReader in = call(
+            ShopRequest(ShopOp::SalesReport).put(value).put(from).put(until));
+        std::vector<SalesBucket> ret;
+        for (std::uint64_t count = in.getVarint(); count > 0; --count) {
+            SalesBucket bucket;
+            in.get(bucket);
+            ret.push_back(bucket);
+        }
+        return ret;
+    }
+
+    bool productSales(const std::string &name, std::time_t from,
+                      std::time_t until, SalesBucket &sales) override {
+        bool ok;
+        call(ShopRequest(ShopOp::ProductSales).put(name).put(from).put(until),
+             &ok)
+            .get(sales);
+        return ok;
+    }
+
+    GroupSummary summarize(ProductGroup group) override {
+        auto value = static_cast<std::uint8_t>(group);
+        ezlib::BufferReader in =
+            call(ShopRequest(ShopOp::Summarize).put(value));
+        GroupSummary ret;
+        for (std::uint64_t count = in.getVarint(); count > 0; --count) {
+            ezlib::Interned key;
+            in.get(key);
+            in.get(ret[key]);
+        }
+        return ret;
+    }
+
+    std::vector<Product> productsByPrice(ezlib::Money from,
+                                         ezlib::Money to) override {
+        return products(
+            ShopRequest(ShopOp::ProductsByPrice).put(from).put(to));
+    }
+
+    std::vector<Product> productsBelowStock(ezlib::Weight level) override {
+        return products(ShopRequest(ShopOp::ProductsBelowStock).put(level));
+    }
+
+    std::vector<Product> productsExpiring(std::time_t from,
+                                          std::time_t until) override {
+        return products(
+            ShopRequest(ShopOp::ProductsExpiring).put(from).put(until));
+    }
+
+    ezlib::stats::Snapshot stats() override {
+        ezlib::BufferReader in = call(ShopRequest(ShopOp::Stats));
+        ezlib::stats::Snapshot ret(ezlib::stats::counterCount, 0);
+        std::uint64_t count = in.getVarint();
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::uint64_t value = in.getVarint();
+            if (i < ret.size()) {
+                ret[i] = value;
+            }
+        }
+        return ret;
+    }
+
+    void resetStats() override { call(ShopRequest(ShopOp::ResetStats)); }
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ezlib {
+namespace stats {
+
+// Build with EZLIB_STATS defined to collect counters. Without it every call
+// below is a no-op the compiler drops.
+#ifdef EZLIB_STATS
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum Counter {
+    ListNodeHops,
+    ListComparisons,
+    ListAllocations,
+    TableLoadNs,
+    TableSaveNs,
+    TableLookups,
+    TableMisses,
+    PrintBytes,
+    PrintNs,
+    counterCount
+};
+
+inline const char *counterName(Counter counter) {
+    static const char *names[counterCount] = {
+        "list.node_hops", "list.comparisons", "list.allocations",
+        "table.load_ns",  "table.save_ns",    "table.lookups",
+        "table.misses",   "print.bytes",      "print.ns",
+    };
+    return names[counter];
+}
+
+using Snapshot = std::vector<std::uint64_t>;
+
+// Every thread counts into its own block; only the owner writes to it, so
+// plain relaxed loads and stores are enough. Blocks of finished threads are
+// folded into `retired`.
+struct ThreadBlock;
+
+class Registry {
+  private:
+    std::mutex lock;
+    std::vector<ThreadBlock *> blocks;
+    std::uint64_t retired[counterCount] = {};
+
+  public:
+    // Never destroyed, so threads and atexit handlers can use it until the
+    // very end of the process.
+    static Registry &instance() {
+        static Registry *registry = new Registry;
+        return *registry;
+    }
+
+    void attach(ThreadBlock *block);
+    void detach(ThreadBlock *block);
+    Snapshot snapshot();
+    void reset();
+};
+
+struct ThreadBlock {
+    std::atomic<std::uint64_t> values[counterCount];
+
+    ThreadBlock() {
+        for (auto &value : values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+        Registry::instance().attach(this);
+    }
+    ~ThreadBlock() { Registry::instance().detach(this); }
+};
+
+inline void Registry::attach(ThreadBlock *block) {
+    std::lock_guard<std::mutex> guard(lock);
+    blocks.push_back(block);
+}
+
+inline void Registry::detach(ThreadBlock *block) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < counterCount; ++i) {
+        retired[i] += block->values[i].load(std::memory_order_relaxed);
+    }
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        if (*it == block) {
+            blocks.erase(it);
+            break;
+        }
+    }
+}
+
+inline Snapshot Registry::snapshot() {
+    std::lock_guard<std::mutex> guard(lock);
+    Snapshot ret(retired, retired + counterCount);
+    for (ThreadBlock *block : blocks) {
+        for (int i = 0; i < counterCount; ++i) {
+            ret[i] += block->values[i].load(std::memory_order_relaxed);
+        }
+    }
+    return ret;
+}
+
+inline void Registry::reset() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &value : retired) {
+        value = 0;
+    }
+    for (ThreadBlock *block : blocks) {
+        for (auto &value : block->values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+inline ThreadBlock &local() {
+    thread_local ThreadBlock block;
+    return block;
+}
+
+inline void add(Counter counter, std::uint64_t n = 1) {
+    if (!enabled) {
+        return;
+    }
+    std::atomic<std::uint64_t> &value = local().values[counter];
+    value.store(value.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+}
+
+// Adds the nanoseconds spent in its scope to a counter.
+class ScopedTimer {
+  private:
+    using Clock = std::chrono::steady_clock;
+    Counter counter;
+    Clock::time_point start;
+
+  public:
+    explicit ScopedTimer(Counter c) : counter(c) {
+        if (enabled) {
+            start = Clock::now();
+        }
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+    ~ScopedTimer() {
+        if (enabled) {
+            add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - start)
+                             .count());
+        }
+    }
+};
+
+inline Snapshot snapshot() {
+    if (!enabled) {
+        return Snapshot(counterCount, 0);
+    }
+    return Registry::instance().snapshot();
+}
+
+inline void reset() {
+    if (enabled) {
+        Registry::instance().reset();
+    }
+}
+
+inline std::string toJson() {
+    Snapshot values = snapshot();
+    std::ostringstream os;
+    os << "{";
+    for (int i = 0; i < counterCount; ++i) {
+        os << (i == 0 ? "\n" : ",\n") << "  \""
+           << counterName(static_cast<Counter>(i)) << "\": " << values[i];
+    }
+    os << "\n}\n";
+    return os.str();
+}
+
+inline bool dumpJson(const std::string &path) {
+    if (!enabled) {
+        return false;
+    }
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    out << toJson();
+    return static_cast<bool>(out);
+}
+
+} // namespace stats
+} // namespace ezlib
+
+#endif
@@ -1,3 +1,9 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "memory.hpp"
+#include "stats.hpp"
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -7,10 +13,16 @@
 namespace ezlib {
 using Row = std::vector<std::string>;
 class Table {
+  public:
+    using Rows = std::vector<Row, CountingAllocator<Row>>;
 
   private:
-    std::vector<Row> rows;
-    std::vector<int> columnMax;
+    // Covers the row and column arrays, not the cells themselves. Charged
+    // to `account`, which is `memory` unless the table shares another one.
+    MemoryAccount memory;
+    MemoryAccount *account;
+    Rows rows;
+    std::vector<int, CountingAllocator<int>> columnMax;
     int padding;
     int rowSize;
     char _horizontal;
@@ -25,18 +37,20 @@ class Table {
     }
     char _corner;
 
-    void printDelim() {
-        std::stringstream ss;
+    void printDelim(std::ostream &os) {
         for (const int &max : columnMax) {
-            ss << _corner << repeat(max + padding, _horizontal);
+            os << _corner << repeat(max + padding, _horizontal);
         }
-        ss << _corner;
-        std::cout << ss.str() << std::endl;
+        os << _corner << '\n';
     }
 
   public:
-    Table(char horizontal, char vertical, char corner)
-        : _vertical(vertical), _horizontal(horizontal), _corner(corner) {
+    Table(char horizontal, char vertical, char corner,
+          MemoryAccount *shared = nullptr)
+        : account(shared != nullptr ? shared : &memory),
+          rows(CountingAllocator<Row>(account)),
+          columnMax(CountingAllocator<int>(account)), _vertical(vertical),
+          _horizontal(horizontal), _corner(corner) {
         rowSize = 0;
         padding = 2;
     }
@@ -47,7 +61,12 @@ class Table {
         columnMax.clear();
     }
 
-    std::vector<Row> &getRows() { return rows; }
+    Rows &getRows() { return rows; }
+
+    Table(const Table &) = delete;
+    Table &operator=(const Table &) = delete;
+
+    const MemoryAccount &getMemory() const { return *account; }
 
     void addRow(const Row &row) {
         if (rowSize == 0) {
@@ -66,33 +85,48 @@ class Table {
         }
     }
 
+    // Fits the columns to the cells again after they were edited through
+    // getRows().
     void recalc() {
-        for (std::size_t i = 0; i < rows.size(); ++i) {
-            for (auto it = rows[i].begin(); it != rows[i].end(); ++it) {
-                if (it->size() > columnMax[i]) {
-                    columnMax[i] = it->size();
+        std::fill(columnMax.begin(), columnMax.end(), 0);
+        for (const Row &row : rows) {
+            for (int i = 0; i < rowSize; i++) {
+                if (row[i].size() > columnMax[i]) {
+                    columnMax[i] = row[i].size();
                 }
             }
         }
     }
 
-    void print() {
-        for (std::vector<Row>::const_iterator rows_it = rows.begin();
+    std::string render() {
+        std::ostringstream ss;
+        for (Rows::const_iterator rows_it = rows.begin();
              rows_it != rows.end(); rows_it++) {
             if (rows_it == rows.begin()) {
-                printDelim();
+                printDelim(ss);
             }
             for (int i = 0; i < rowSize; i++) {
-                std::cout << _vertical;
-                std::cout << std::setw(columnMax[i] + padding);
-                std::cout << std::left << (*rows_it)[i];
+                ss << _vertical;
+                ss << std::setw(columnMax[i] + padding);
+                ss << std::left << (*rows_it)[i];
                 if (i == rowSize - 1) {
-                    std::cout << _vertical;
+                    ss << _vertical;
                 }
             }
-            std::cout << std::endl;
-            printDelim();
+            ss << '\n';
+            printDelim(ss);
         }
+        return ss.str();
+    }
+
+    // Renders the whole table first and writes it with a single call.
+    void print() {
+        stats::ScopedTimer timer(stats::PrintNs);
+        std::string out = render();
+        stats::add(stats::PrintBytes, out.size());
+        std::cout << out << std::flush;
     }
 };
 } // namespace ezlib
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include "stats.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace ezlib {
+
+// The top of the terminal, drawn with ANSI sequences. draw() keeps the frame
+// it has shown and on the next call only rewrites the characters that
+// differ, so editing one cell of a table sends that cell and not the whole
+// screen. Output that is not a terminal gets every frame in full and no
+// escape sequences.
+//
+// Whatever is printed after a frame (prompts, messages, echoed input) is
+// wiped by the next draw(). Anything else printed at the top must come after
+// clear(), which makes the next frame start from scratch.
+class Screen {
+  private:
+    std::vector<std::string> shown;
+    // False once the terminal has scrolled since the last clear, lines are
+    // then no longer where they were drawn.
+    bool placed = false;
+    bool ansi;
+
+    Screen() {
+#ifdef _WIN32
+        ansi = false;
+#else
+        ansi = ::isatty(STDOUT_FILENO) == 1;
+#endif
+    }
+
+    static void terminalSize(std::size_t &rows, std::size_t &columns) {
+        rows = 24;
+        columns = 80;
+#ifndef _WIN32
+        winsize size{};
+        if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+            rows = size.ws_row;
+            columns = size.ws_col;
+        }
+#endif
+    }
+
+    // Lines with tabs, control or multibyte characters do not map bytes to
+    // columns, they are always rewritten whole.
+    static bool plain(const std::string &line) {
+        for (char c : line) {
+            if (c < 0x20 || c > 0x7e) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void moveTo(std::string &out, std::size_t row, std::size_t column) {
+        out += "\x1b[" + std::to_string(row + 1) + ";" +
+               std::to_string(column + 1) + "H";
+    }
+
+    static void write(const std::string &out) {
+        stats::add(stats::PrintBytes, out.size());
+        std::cout << out << std::flush;
+    }
+
+    // Appends what turns line `row` from `from` into `to`.
+    static void diffLine(std::string &out, std::size_t row,
+                         const std::string &from, const std::string &to) {
+        if (!plain(from) || !plain(to)) {
+            moveTo(out, row, 0);
+            out += to;
+            out += "\x1b[K";
+            return;
+        }
+        std::size_t first = 0;
+        while (first < from.size() && first < to.size() &&
+               from[first] == to[first]) {
+            ++first;
+        }
+        moveTo(out, row, first);
+        if (from.size() == to.size()) {
+            // Only the changed middle, e.g. one cell of a table.
+            std::size_t last = to.size();
+            while (last > first && from[last - 1] == to[last - 1]) {
+                --last;
+            }
+            out.append(to, first, last - first);
+        } else {
+            out.append(to, first, std::string::npos);
+            out += "\x1b[K";
+        }
+    }
+
+  public:
+    Screen(const Screen &) = delete;
+    Screen &operator=(const Screen &) = delete;
+
+    static Screen &global() {
+        static Screen screen;
+        return screen;
+    }
+
+    void clear() {
+        shown.clear();
+        placed = true;
+        if (ansi) {
+            write("\x1b[H\x1b[2J");
+        }
+#ifdef _WIN32
+        std::system("cls");
+#endif
+    }
+
+    // Shows `frame` at the top and leaves the cursor on the line below it,
+    // with the rest of the screen cleared. `footer` is how many lines the
+    // caller prints below before the next draw(); if they would not fit the
+    // terminal scrolls, so the frame is then written in full.
+    void draw(const std::string &frame, std::size_t footer = 4) {
+        stats::ScopedTimer timer(stats::PrintNs);
+        std::vector<std::string> lines;
+        std::size_t start = 0;
+        while (start < frame.size()) {
+            std::size_t end = frame.find('\n', start);
+            if (end == std::string::npos) {
+                end = frame.size();
+            }
+            lines.push_back(frame.substr(start, end - start));
+            start = end + 1;
+        }
+        if (!ansi) {
+            write(frame);
+            return;
+        }
+        std::size_t rows, columns;
+        terminalSize(rows, columns);
+        bool fits = lines.size() + footer <= rows;
+        for (const std::string &line : lines) {
+            fits = fits && line.size() < columns;
+        }
+        if (!fits || !placed) {
+            shown.clear();
+            placed = fits;
+            write("\x1b[H\x1b[2J" + frame);
+            if (fits) {
+                shown = lines;
+            }
+            return;
+        }
+        std::string out;
+        for (std::size_t row = 0; row < lines.size(); ++row) {
+            if (row >= shown.size()) {
+                diffLine(out, row, "", lines[row]);
+            } else if (shown[row] != lines[row]) {
+                diffLine(out, row, shown[row], lines[row]);
+            }
+        }
+        moveTo(out, lines.size(), 0);
+        out += "\x1b[J";
+        write(out);
+        shown.swap(lines);
+    }
+};
+
+} // namespace ezlib
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include "intern.hpp"
+#include "rangeIndex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Prefix and substring search over Interned members of the rows, ignoring
+// ASCII case. Every distinct string is indexed once, however many rows share
+// it: its words go into sorted lists for prefix lookups and its trigrams
+// into posting lists for substring lookups. Strings no row uses any more
+// stay in the lists until enough of them pile up to rebuild.
+template <typename T> class TextIndex : public RowIndex<T> {
+  public:
+    using Field = ezlib::Interned T::*;
+
+  private:
+    struct Text {
+        const std::string *str;
+        // Keeps *str in the pool until the text is dropped, dead or not.
+        ezlib::Interned value;
+        std::vector<T *> rows;
+    };
+
+    // The part of a text from the start of one of its words. `head` holds
+    // its first bytes folded, so most comparisons need not read the text.
+    struct Word {
+        std::uint64_t head;
+        std::uint32_t text;
+        std::uint32_t start;
+    };
+
+    // Sorted words, and words added since the last merge.
+    struct WordList {
+        std::vector<Word> sorted;
+        std::vector<Word> pending;
+    };
+
+    struct FieldIndex {
+        Field member;
+        std::unordered_map<const std::string *, std::uint32_t> ids;
+        // Whole texts, and the words after the first one.
+        WordList wholes;
+        WordList words;
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> grams;
+    };
+
+    std::vector<FieldIndex> fields;
+    std::vector<Text> texts;
+    std::size_t deadTexts = 0;
+    // Set while many texts are added at once, they are sorted at the end.
+    bool bulk = false;
+
+    static unsigned char fold(char c) {
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+
+    static bool isWordChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0;
+    }
+
+    static std::uint32_t gram(const std::string &str, std::size_t pos) {
+        return fold(str[pos]) << 16 | fold(str[pos + 1]) << 8 |
+               fold(str[pos + 2]);
+    }
+
+    static std::vector<std::uint32_t> grams(const std::string &str) {
+        std::vector<std::uint32_t> ret;
+        for (std::size_t i = 0; i + 3 <= str.size(); ++i) {
+            ret.push_back(gram(str, i));
+        }
+        std::sort(ret.begin(), ret.end());
+        ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+        return ret;
+    }
+
+    // Orders texts from `start` like their lowercase forms would be.
+    static bool foldedLess(const std::string &lhs, std::size_t lhsStart,
+                           const std::string &rhs, std::size_t rhsStart) {
+        return std::lexicographical_compare(
+            lhs.begin() + lhsStart, lhs.end(), rhs.begin() + rhsStart,
+            rhs.end(), [](char a, char b) { return fold(a) < fold(b); });
+    }
+
+    // Eight bytes of `str` from `pos` folded, zero past its end, so they
+    // compare as numbers the way the texts do.
+    static std::uint64_t chunk(const std::string &str, std::size_t pos) {
+        std::uint64_t ret = 0;
+        for (std::size_t i = pos; i < pos + sizeof(ret); ++i) {
+            ret = ret << 8 | (i < str.size() ? fold(str[i]) : 0);
+        }
+        return ret;
+    }
+
+    static Word makeWord(const std::string &str, std::uint32_t text,
+                         std::uint32_t start) {
+        return Word{chunk(str, start), text, start};
+    }
+
+    bool less(const Word &lhs, const Word &rhs) const {
+        if (lhs.head != rhs.head) {
+            return lhs.head < rhs.head;
+        }
+        const std::string &lhsStr = *texts[lhs.text].str;
+        const std::string &rhsStr = *texts[rhs.text].str;
+        std::size_t lhsRest = lhs.start + sizeof(lhs.head);
+        std::size_t rhsRest = rhs.start + sizeof(rhs.head);
+        return foldedLess(lhsStr, std::min(lhsStr.size(), lhsRest), rhsStr,
+                          std::min(rhsStr.size(), rhsRest));
+    }
+
+    // Negative if the word sorts before every word starting with `key`
+    // (already lowercase), zero if it starts with it.
+    int comparePrefix(const Word &word, const std::string &key) const {
+        const std::string &str = *texts[word.text].str;
+        std::size_t i = word.start;
+        for (std::size_t j = 0; j < key.size(); ++i, ++j) {
+            if (i == str.size()) {
+                return -1;
+            }
+            unsigned char c = fold(str[i]);
+            unsigned char k = key[j];
+            if (c != k) {
+                return c < k ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    bool alive(std::uint32_t text) const { return !texts[text].rows.empty(); }
+
+    // Sorts words whose texts agree up to `depth` bytes from their starts,
+    // by the next eight bytes and then each run of equal ones deeper. Every
+    // text is read once per level instead of on every comparison.
+    void sortWords(Word *first, Word *last, std::size_t depth) {
+        if (last - first < 32) {
+            std::sort(first, last, [this](const Word &lhs, const Word &rhs) {
+                return less(lhs, rhs);
+            });
+            return;
+        }
+        std::vector<std::pair<std::uint64_t, Word>> keyed;
+        keyed.reserve(last - first);
+        for (Word *it = first; it != last; ++it) {
+            keyed.emplace_back(
+                depth == 0 ? it->head
+                           : chunk(*texts[it->text].str, it->start + depth),
+                *it);
+        }
+        std::sort(keyed.begin(), keyed.end(),
+                  [](const std::pair<std::uint64_t, Word> &lhs,
+                     const std::pair<std::uint64_t, Word> &rhs) {
+                      return lhs.first < rhs.first;
+                  });
+        for (std::size_t i = 0; i < keyed.size(); ++i) {
+            first[i] = keyed[i].second;
+        }
+        for (std::size_t i = 0, end; i < keyed.size(); i = end) {
+            for (end = i + 1;
+                 end < keyed.size() && keyed[end].first == keyed[i].first;
+                 ++end) {
+            }
+            // Texts ending within the eight bytes are equal.
+            if (end - i > 1 && (keyed[i].first & 0xff) != 0) {
+                sortWords(first + i, first + end, depth + 8);
+            }
+        }
+    }
+
+    void merge(WordList &list) {
+        auto byText = [this](const Word &lhs, const Word &rhs) {
+            return less(lhs, rhs);
+        };
+        sortWords(list.pending.data(),
+                  list.pending.data() + list.pending.size(), 0);
+        std::size_t middle = list.sorted.size();
+        list.sorted.insert(list.sorted.end(), list.pending.begin(),
+                           list.pending.end());
+        std::inplace_merge(list.sorted.begin(), list.sorted.begin() + middle,
+                           list.sorted.end(), byText);
+        list.pending.clear();
+    }
+
+    // Merging costs a pass over the sorted list, so pending words are let
+    // grow in proportion to it.
+    void add(WordList &list, const Word &word) {
+        list.pending.push_back(word);
+        if (!bulk && list.pending.size() > list.sorted.size() / 8 + 4096) {
+            merge(list);
+        }
+    }
+
+    std::uint32_t addText(FieldIndex &field, const ezlib::Interned &value) {
+        const std::string *str = &value.str();
+        std::uint32_t id = texts.size();
+        texts.push_back(Text{str, value, {}});
+        field.ids[str] = id;
+        add(field.wholes, makeWord(*str, id, 0));
+        for (std::uint32_t i = 1; i < str->size(); ++i) {
+            if (isWordChar((*str)[i]) && !isWordChar((*str)[i - 1])) {
+                add(field.words, makeWord(*str, id, i));
+            }
+        }
+        for (std::uint32_t g : grams(*str)) {
+            field.grams[g].push_back(id);
+        }
+        return id;
+    }
+
+    void mergeAll() {
+        for (FieldIndex &field : fields) {
+            merge(field.wholes);
+            merge(field.words);
+        }
+    }
+
+    // Indexes the live texts again, dropping the dead ones.
+    void rebuild() {
+        std::vector<Text> old;
+        old.swap(texts);
+        std::vector<std::size_t> fieldOf(old.size());
+        for (FieldIndex &field : fields) {
+            for (const auto &entry : field.ids) {
+                fieldOf[entry.second] = &field - fields.data();
+            }
+            field.ids.clear();
+            field.wholes = WordList();
+            field.words = WordList();
+            field.grams.clear();
+        }
+        deadTexts = 0;
+        bulk = true;
+        for (std::size_t id = 0; id < old.size(); ++id) {
+            if (!old[id].rows.empty()) {
+                FieldIndex &field = fields[fieldOf[id]];
+                std::uint32_t added = addText(field, old[id].value);
+                texts[added].rows.swap(old[id].rows);
+            }
+        }
+        bulk = false;
+        mergeAll();
+    }
+
+    // Texts with a word (or the whole text) starting with `key`, in order,
+    // until they hold at least `wanted` rows.
+    std::vector<std::uint32_t> prefixMatches(WordList &list,
+                                             const std::string &key,
+                                             std::size_t wanted) {
+        if (list.pending.size() > 4096) {
+            merge(list);
+        }
+        std::vector<Word> found;
+        auto it = std::lower_bound(list.sorted.begin(), list.sorted.end(),
+                                   key, [this](const Word &w,
+                                               const std::string &k) {
+                                       return comparePrefix(w, k) < 0;
+                                   });
+        std::size_t rows = 0;
+        for (; it != list.sorted.end() && rows < wanted &&
+               comparePrefix(*it, key) == 0;
+             ++it) {
+            if (alive(it->text)) {
+                found.push_back(*it);
+                rows += texts[it->text].rows.size();
+            }
+        }
+        for (const Word &word : list.pending) {
+            if (alive(word.text) && comparePrefix(word, key) == 0) {
+                found.push_back(word);
+            }
+        }
+        std::sort(found.begin(), found.end(),
+                  [this](const Word &lhs, const Word &rhs) {
+                      return less(lhs, rhs);
+                  });
+        std::vector<std::uint32_t> ret;
+        for (const Word &word : found) {
+            ret.push_back(word.text);
+        }
+        return ret;
+    }
+
+    // The alphabetically first `wanted` texts containing `key`. Only the
+    // shortest posting list among the trigrams of the key is checked.
+    std::vector<std::uint32_t> substringMatches(FieldIndex &field,
+                                                const std::string &key,
+                                                std::size_t wanted) {
+        std::vector<std::uint32_t> ret;
+        const std::vector<std::uint32_t> *shortest = nullptr;
+        for (std::uint32_t g : grams(key)) {
+            auto found = field.grams.find(g);
+            if (found == field.grams.end()) {
+                return ret;
+            }
+            if (shortest == nullptr ||
+                found->second.size() < shortest->size()) {
+                shortest = &found->second;
+            }
+        }
+        for (std::uint32_t id : *shortest) {
+            const std::string &str = *texts[id].str;
+            if (alive(id) &&
+                std::search(str.begin(), str.end(), key.begin(), key.end(),
+                            [](char a, char b) { return fold(a) == b; }) !=
+                    str.end()) {
+                ret.push_back(id);
+            }
+        }
+        auto alphabetical = [this](std::uint32_t lhs, std::uint32_t rhs) {
+            return foldedLess(*texts[lhs].str, 0, *texts[rhs].str, 0);
+        };
+        if (ret.size() > wanted) {
+            std::nth_element(ret.begin(), ret.begin() + wanted, ret.end(),
+                             alphabetical);
+            ret.resize(wanted);
+        }
+        std::sort(ret.begin(), ret.end(), alphabetical);
+        return ret;
+    }
+
+  public:
+    explicit TextIndex(const std::vector<Field> &members) {
+        for (Field member : members) {
+            fields.push_back(FieldIndex());
+            fields.back().member = member;
+        }
+    }
+
+    void insert(T *row) override {
+        for (FieldIndex &field : fields) {
+            const ezlib::Interned &value = row->*field.member;
+            auto found = field.ids.find(&value.str());
+            std::uint32_t id;
+            if (found == field.ids.end()) {
+                id = addText(field, value);
+            } else {
+                id = found->second;
+                if (!alive(id)) {
+                    deadTexts--;
+                }
+            }
+            texts[id].rows.push_back(row);
+        }
+    }
+
+    void erase(T *row) override {
+        for (FieldIndex &field : fields) {
+            auto found = field.ids.find(&(row->*field.member).str());
+            if (found == field.ids.end()) {
+                continue;
+            }
+            std::vector<T *> &rows = texts[found->second].rows;
+            auto it = std::find(rows.begin(), rows.end(), row);
+            if (it != rows.end()) {
+                rows.erase(it);
+                if (rows.empty()) {
+                    deadTexts++;
+                }
+            }
+        }
+        if (deadTexts > texts.size() / 4 + 1024) {
+            rebuild();
+        }
+    }
+
+    // Same as inserting the rows one by one, but cheaper for many rows.
+    template <typename Iterator> void insertAll(Iterator first, Iterator last) {
+        bulk = true;
+        for (; first != last; ++first) {
+            insert(&*first);
+        }
+        bulk = false;
+        mergeAll();
+    }
+
+    bool differs(const T &from, const T &to) const override {
+        for (const FieldIndex &field : fields) {
+            if (from.*field.member != to.*field.member) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // At most `limit` rows matching `query`, best first: fields starting
+    // with it, then fields with a word starting with it, then fields
+    // containing it (three characters or more). Within each group earlier
+    // fields come first, then the texts in alphabetical order from where
+    // they match (from the start for substrings).
+    std::vector<const T *> search(const std::string &query,
+                                  std::size_t limit) {
+        std::string key;
+        for (char c : query) {
+            key += fold(c);
+        }
+        std::vector<const T *> ret;
+        if (key.empty() || limit == 0) {
+            return ret;
+        }
+        std::unordered_set<T *> seen;
+        auto take = [&](const std::vector<std::uint32_t> &ids) {
+            for (std::uint32_t id : ids) {
+                for (T *row : texts[id].rows) {
+                    if (ret.size() == limit) {
+                        return;
+                    }
+                    if (seen.insert(row).second) {
+                        ret.push_back(row);
+                    }
+                }
+            }
+        };
+        for (FieldIndex &field : fields) {
+            take(prefixMatches(field.wholes, key, limit - ret.size()));
+        }
+        for (FieldIndex &field : fields) {
+            take(prefixMatches(field.words, key, limit - ret.size()));
+        }
+        for (FieldIndex &field : fields) {
+            if (key.size() >= 3 && ret.size() < limit) {
+                // Every text has a row, but the rows of up to ret.size()
+                // texts may be taken already.
+                take(substringMatches(field, key, limit));
+            }
+        }
+        return ret;
+    }
+};
+
+#endif
@@ -0,0 +1,386 @@
+#ifndef UNIXSOCKET_H
+#define UNIXSOCKET_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <signal.h>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ezlib {
+
+// Messages on the socket are frames: a uint32 payload size in native byte
+// order, then the payload. Responses come back in request order, so a client
+// may send several requests before reading any response.
+constexpr std::uint32_t maxFrameSize = 64 << 20;
+
+inline std::runtime_error socketError(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+inline sockaddr_un socketAddress(const std::string &path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+// Blocking client side of a SocketServer.
+class SocketClient {
+  private:
+    int fd;
+    std::string out;
+    std::string in;
+    std::size_t inPos = 0;
+
+    void fill() {
+        char buf[65536];
+        ssize_t n;
+        do {
+            n = ::read(fd, buf, sizeof(buf));
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            throw socketError("Cannot read from server");
+        }
+        if (n == 0) {
+            throw std::runtime_error("Server closed the connection");
+        }
+        in.append(buf, n);
+    }
+
+  public:
+    explicit SocketClient(const std::string &path) {
+        sockaddr_un addr = socketAddress(path);
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw socketError("Cannot create socket");
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+            0) {
+            std::runtime_error error = socketError("Cannot connect to " + path);
+            ::close(fd);
+            throw error;
+        }
+    }
+    SocketClient(const SocketClient &) = delete;
+    SocketClient &operator=(const SocketClient &) = delete;
+    ~SocketClient() { ::close(fd); }
+
+    // Queues a request until flush().
+    void send(const std::string &payload) {
+        std::uint32_t size = payload.size();
+        out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        out.append(payload);
+    }
+
+    // Writes all queued requests at once. The server stops reading while its
+    // responses are not taken, so do not queue more than the socket buffers
+    // hold (a few hundred small requests) before reading.
+    void flush() {
+        std::size_t pos = 0;
+        while (pos < out.size()) {
+            ssize_t n =
+                ::send(fd, out.data() + pos, out.size() - pos, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw socketError("Cannot write to server");
+            }
+            pos += n;
+        }
+        out.clear();
+    }
+
+    // Next response, blocks until it has arrived.
+    std::string receive() {
+        std::uint32_t size;
+        while (in.size() - inPos < sizeof(size)) {
+            fill();
+        }
+        std::memcpy(&size, in.data() + inPos, sizeof(size));
+        if (size > maxFrameSize) {
+            throw std::runtime_error("Response is too large");
+        }
+        while (in.size() - inPos < sizeof(size) + size) {
+            fill();
+        }
+        std::string ret = in.substr(inPos + sizeof(size), size);
+        inPos += sizeof(size) + size;
+        if (inPos == in.size()) {
+            in.clear();
+            inPos = 0;
+        }
+        return ret;
+    }
+
+    std::string call(const std::string &payload) {
+        send(payload);
+        flush();
+        return receive();
+    }
+};
+
+// Single threaded epoll loop serving frames on a Unix domain socket. Each
+// request frame is handed to the handler, which appends its response. All
+// responses to the requests found by one read leave in a single write.
+class SocketServer {
+  public:
+    using Handler = std::function<void(const char *data, std::size_t size,
+                                       std::string &response)>;
+
+  private:
+    struct Connection {
+        std::string in;
+        std::string out;
+        std::size_t outPos = 0;
+        bool writing = false;
+    };
+
+    std::string path;
+    Handler handler;
+    int listenFd = -1;
+    int epollFd = -1;
+    int signalFd = -1;
+    sigset_t oldMask;
+    std::map<int, Connection> connections;
+
+    void watch(int fd, std::uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epollFd, op, fd, &ev) != 0) {
+            throw socketError("Cannot watch socket");
+        }
+    }
+
+    void closeConnection(int fd) {
+        ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = ::accept4(listenFd, nullptr, nullptr,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            connections[fd];
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+        }
+    }
+
+    // Reads what the client has sent and answers every complete request.
+    // False if the connection is finished.
+    bool readRequests(int fd, Connection &conn) {
+        char buf[65536];
+        while (true) {
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n > 0) {
+                conn.in.append(buf, n);
+                if (static_cast<std::size_t>(n) < sizeof(buf)) {
+                    break;
+                }
+            } else if (n == 0) {
+                return false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+        std::size_t pos = 0;
+        std::uint32_t size;
+        while (conn.in.size() - pos >= sizeof(size)) {
+            std::memcpy(&size, conn.in.data() + pos, sizeof(size));
+            if (size > maxFrameSize) {
+                return false;
+            }
+            if (conn.in.size() - pos - sizeof(size) < size) {
+                break;
+            }
+            std::size_t sizePos = conn.out.size();
+            conn.out.append(sizeof(size), '\0');
+            handler(conn.in.data() + pos + sizeof(size), size, conn.out);
+            std::uint32_t responseSize =
+                conn.out.size() - sizePos - sizeof(size);
+            std::memcpy(&conn.out[sizePos], &responseSize, sizeof(size));
+            pos += sizeof(size) + size;
+        }
+        conn.in.erase(0, pos);
+        return true;
+    }
+
+    // False if the client has gone away.
+    bool writeResponses(int fd, Connection &conn) {
+        while (conn.outPos < conn.out.size()) {
+            ssize_t n = ::send(fd, conn.out.data() + conn.outPos,
+                               conn.out.size() - conn.outPos, MSG_NOSIGNAL);
+            if (n >= 0) {
+                conn.outPos += n;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+        bool pending = conn.outPos < conn.out.size();
+        if (!pending) {
+            conn.out.clear();
+            conn.outPos = 0;
+        }
+        if (pending != conn.writing) {
+            // Stop taking requests from a client that does not read its
+            // responses.
+            watch(fd, pending ? EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD);
+            conn.writing = pending;
+        }
+        return true;
+    }
+
+    void shutdown() {
+        for (auto &conn : connections) {
+            ::close(conn.first);
+        }
+        connections.clear();
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(path.c_str());
+        }
+        if (signalFd >= 0) {
+            ::close(signalFd);
+            ::pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+        }
+        if (epollFd >= 0) {
+            ::close(epollFd);
+        }
+    }
+
+    void open() {
+        sockaddr_un addr = socketAddress(path);
+        if (isListening(path)) {
+            throw std::runtime_error("Server is already running on " + path);
+        }
+        ::unlink(path.c_str());
+        listenFd =
+            ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            throw socketError("Cannot create socket");
+        }
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr),
+                   sizeof(addr)) != 0 ||
+            ::listen(listenFd, SOMAXCONN) != 0) {
+            throw socketError("Cannot listen on " + path);
+        }
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) {
+            throw socketError("Cannot create epoll instance");
+        }
+        // SIGINT and SIGTERM end run() instead of the process, so the owner
+        // gets to save its state.
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        ::pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+        signalFd = ::signalfd(-1, &mask, SFD_CLOEXEC);
+        if (signalFd < 0) {
+            ::pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+            throw socketError("Cannot create signalfd");
+        }
+        watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(signalFd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+  public:
+    // A stale socket file left by a crashed server is replaced.
+    SocketServer(const std::string &socketPath, Handler h)
+        : path(socketPath), handler(std::move(h)) {
+        try {
+            open();
+        } catch (...) {
+            shutdown();
+            throw;
+        }
+    }
+    SocketServer(const SocketServer &) = delete;
+    SocketServer &operator=(const SocketServer &) = delete;
+    ~SocketServer() { shutdown(); }
+
+    // True if a server accepts connections on `socketPath`.
+    static bool isListening(const std::string &socketPath) {
+        try {
+            SocketClient client(socketPath);
+            return true;
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+    }
+
+    // Serves clients until SIGINT or SIGTERM. A client sending a malformed
+    // request, or one the handler throws on, is disconnected.
+    void run() {
+        epoll_event events[64];
+        while (true) {
+            int n = ::epoll_wait(epollFd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw socketError("Cannot wait for clients");
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == signalFd) {
+                    signalfd_siginfo info;
+                    ssize_t got = ::read(signalFd, &info, sizeof(info));
+                    (void)got;
+                    return;
+                }
+                if (fd == listenFd) {
+                    acceptAll();
+                    continue;
+                }
+                auto found = connections.find(fd);
+                if (found == connections.end()) {
+                    continue;
+                }
+                Connection &conn = found->second;
+                bool keep = (events[i].events & EPOLLERR) == 0;
+                try {
+                    if (keep && !conn.writing) {
+                        keep = readRequests(fd, conn);
+                    }
+                    if (keep) {
+                        keep = writeResponses(fd, conn);
+                    }
+                } catch (const std::exception &e) {
+                    keep = false;
+                }
+                if (!keep) {
+                    closeConnection(fd);
+                }
+            }
+        }
+    }
+};
+
+} // namespace ezlib
+
+#endif
@@ -1,3 +1,4 @@
+#include "fixed.hpp"
 #include <iostream>
 #include <limits>
 #include <string>
@@ -37,12 +38,20 @@ template <> int from_string(const std::string &str) {
 }
 template <> float from_string(const std::string &str) { return std::stof(str); }
 template <> std::string from_string(const std::string &str) { return str; }
+template <> Money from_string(const std::string &str) {
+    return Money::parse(str);
+}
+template <> Weight from_string(const std::string &str) {
+    return Weight::parse(str);
+}
 
 template <typename T> std::string makeFallback();
 
 template <> std::string makeFallback<float>() { return "float"; }
 template <> std::string makeFallback<int>() { return "integer"; }
 template <> std::string makeFallback<std::string>() { return "string"; }
+template <> std::string makeFallback<Money>() { return "money"; }
+template <> std::string makeFallback<Weight>() { return "weight"; }
 
 template <typename T> T input(const std::string &prompt) {
     T ret;